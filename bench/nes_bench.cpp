@@ -0,0 +1,278 @@
+/// File: nes_bench.cpp
+/// Description: A benchmark of the throughput of each part of the emulator.
+///
+/// Usage: nes_bench [--frames N] [--repeat N] [--warmup N] [--json] [ROM ...]
+///
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+#include "nes_env.hpp"
+
+/// the ROM to benchmark when none are given on the command line
+const char* DEFAULT_ROM = "nes_py/tests/games/smb1.nes";
+/// the number of bytes in a screen (32-bit pixels)
+const int SCREEN_BYTES = 256 * 240 * 4;
+/// the number of frames between rendered frames in the render-skip case
+const int FRAME_SKIP = 4;
+
+/// The options of a benchmark run.
+struct Options {
+    /// the number of operations to time in each repetition
+    int frames = 2000;
+    /// the number of timed repetitions of each case
+    int repeat = 5;
+    /// the number of frames to emulate before timing
+    int warmup = 600;
+    /// whether to print the results as JSON
+    bool json = false;
+    /// the paths of the ROMs to benchmark
+    std::vector<std::string> roms;
+};
+
+/// The timings of a benchmark case.
+struct Result {
+    /// the name of the case
+    std::string name;
+    /// the number of operations per second in each repetition
+    std::vector<double> throughput;
+    /// the latency of each operation in nanoseconds
+    std::vector<double> latency;
+};
+
+/// A generator of controller inputs that plays like an agent would.
+class Inputs {
+private:
+    /// the state of the linear congruential generator
+    u32 seed = 1;
+    /// the number of inputs generated
+    u32 count = 0;
+
+public:
+    /// Return the action for the next frame.
+    u8 next() {
+        // press start periodically to get through the menus
+        if (count++ < 240)
+            return (count % 60 < 5) ? 0x08 : 0x00;
+        seed = seed * 1103515245 + 12345;
+        // mostly run right with random jumps and runs
+        return 0x80 | ((seed >> 16) & 0x03);
+    }
+};
+
+/// Return the value at a percentile of a sorted vector.
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty())
+        return 0;
+    size_t index = static_cast<size_t>(p / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+/**
+    Time repetitions of an operation.
+
+    @param name the name of the case
+    @param options the options of the run
+    @param operation the operation to time
+    @returns the timings of the case
+*/
+Result measure(const std::string& name, const Options& options, std::function<void()> operation) {
+    typedef std::chrono::steady_clock clock;
+    Result result;
+    result.name = name;
+    result.latency.reserve(static_cast<size_t>(options.frames) * options.repeat);
+    for (int r = 0; r < options.repeat; r++) {
+        auto start = clock::now();
+        auto last = start;
+        for (int i = 0; i < options.frames; i++) {
+            operation();
+            auto now = clock::now();
+            result.latency.push_back(std::chrono::duration<double, std::nano>(now - last).count());
+            last = now;
+        }
+        double seconds = std::chrono::duration<double>(last - start).count();
+        result.throughput.push_back(options.frames / seconds);
+    }
+    std::sort(result.latency.begin(), result.latency.end());
+    std::sort(result.throughput.begin(), result.throughput.end());
+    return result;
+}
+
+/**
+    Run every benchmark case on a ROM.
+
+    @param path the path to the ROM
+    @param options the options of the run
+    @returns the timings of each case
+*/
+std::vector<Result> benchmark(const std::string& path, const Options& options) {
+    // the cartridge doesn't report missing files, so check up front
+    FILE* rom = fopen(path.c_str(), "rb");
+    if (rom == nullptr) {
+        fprintf(stderr, "nes_bench: can't open ROM %s\n", path.c_str());
+        exit(1);
+    }
+    fclose(rom);
+    std::wstring wide_path(path.begin(), path.end());
+    NESEnv env(const_cast<wchar_t*>(wide_path.c_str()));
+    env.reset();
+    Inputs inputs;
+    for (int i = 0; i < options.warmup; i++)
+        env.step(inputs.next());
+    std::vector<u8> screen(SCREEN_BYTES);
+    std::vector<Result> results;
+    // emulate and render every frame
+    results.push_back(measure("full", options, [&] {
+        env.step(inputs.next());
+    }));
+    // emulate without rendering (the PPU still runs, but writes no pixels)
+    env.set_render(false);
+    results.push_back(measure("no_render", options, [&] {
+        env.step(inputs.next());
+    }));
+    // render one frame in every FRAME_SKIP frames (the last two frames are
+    // rendered because a screen is drawn across two frames)
+    int frame = 0;
+    results.push_back(measure("render_skip", options, [&] {
+        frame = (frame + 1) % FRAME_SKIP;
+        env.set_render(frame >= FRAME_SKIP - 2);
+        env.step(inputs.next());
+        if (frame == FRAME_SKIP - 1)
+            env.screen(screen.data());
+    }));
+    env.set_render(true);
+    // copy the screen to an output buffer
+    results.push_back(measure("screen_copy", options, [&] {
+        env.screen(screen.data());
+    }));
+    // backup and restore the game-state
+    results.push_back(measure("backup_restore", options, [&] {
+        env.backup();
+        env.restore();
+    }));
+    // serialize and deserialize a snapshot of the machine state
+    StateWriter snapshot;
+    results.push_back(measure("snapshot_save", options, [&] {
+        snapshot.data.clear();
+        env.save_snapshot(snapshot);
+    }));
+    results.push_back(measure("snapshot_load", options, [&] {
+        StateReader stream(snapshot.data.data(), snapshot.data.size());
+        if (!env.load_snapshot(stream)) {
+            fprintf(stderr, "nes_bench: failed to load a snapshot\n");
+            exit(1);
+        }
+    }));
+    return results;
+}
+
+/// Print the results of a ROM as a table.
+void print_table(const std::string& path, const std::vector<Result>& results) {
+    printf("%s\n", path.c_str());
+    printf("  %-16s %12s %10s %10s %10s %10s\n",
+        "case", "ops/sec", "p50 us", "p90 us", "p99 us", "max us");
+    for (const Result& result : results) {
+        printf("  %-16s %12.0f %10.2f %10.2f %10.2f %10.2f\n",
+            result.name.c_str(),
+            percentile(result.throughput, 50),
+            percentile(result.latency, 50) / 1000,
+            percentile(result.latency, 90) / 1000,
+            percentile(result.latency, 99) / 1000,
+            result.latency.back() / 1000
+        );
+    }
+}
+
+/// Return a string escaped for a JSON string literal.
+std::string json_escape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", c);
+            escaped += code;
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+/// Print the results of a ROM as a JSON object.
+void print_json(const std::string& path, const std::vector<Result>& results, bool last) {
+    printf("    {\n      \"rom\": \"%s\",\n      \"cases\": {\n", json_escape(path).c_str());
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& result = results[i];
+        printf("        \"%s\": {\"ops_per_sec\": %.1f, \"ops_per_sec_min\": %.1f, "
+            "\"ops_per_sec_max\": %.1f, \"p50_ns\": %.0f, \"p90_ns\": %.0f, "
+            "\"p99_ns\": %.0f, \"max_ns\": %.0f}%s\n",
+            json_escape(result.name).c_str(),
+            percentile(result.throughput, 50),
+            result.throughput.front(),
+            result.throughput.back(),
+            percentile(result.latency, 50),
+            percentile(result.latency, 90),
+            percentile(result.latency, 99),
+            result.latency.back(),
+            i + 1 < results.size() ? "," : ""
+        );
+    }
+    printf("      }\n    }%s\n", last ? "" : ",");
+}
+
+/// Print the usage of the program and exit.
+void usage(const char* program) {
+    fprintf(stderr,
+        "usage: %s [--frames N] [--repeat N] [--warmup N] [--json] [ROM ...]\n"
+        "  --frames N  operations to time per repetition (default 2000)\n"
+        "  --repeat N  timed repetitions of each case (default 5)\n"
+        "  --warmup N  frames to emulate before timing (default 600)\n"
+        "  --json      print the results as JSON\n", program);
+    exit(2);
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        if (arg == "--json") {
+            options.json = true;
+        } else if (arg == "--frames" || arg == "--repeat" || arg == "--warmup") {
+            if (i + 1 >= argc)
+                usage(argv[0]);
+            int value = atoi(argv[++i]);
+            if (value <= 0 && !(arg == "--warmup" && value == 0))
+                usage(argv[0]);
+            if (arg == "--frames") options.frames = value;
+            else if (arg == "--repeat") options.repeat = value;
+            else options.warmup = value;
+        } else if (arg.compare(0, 2, "--") == 0) {
+            usage(argv[0]);
+        } else {
+            options.roms.push_back(arg);
+        }
+    }
+    if (options.roms.empty())
+        options.roms.push_back(DEFAULT_ROM);
+
+    if (options.json)
+        printf("{\n  \"frames\": %d,\n  \"repeat\": %d,\n  \"warmup\": %d,\n  \"roms\": [\n",
+            options.frames, options.repeat, options.warmup);
+    for (size_t i = 0; i < options.roms.size(); i++) {
+        std::vector<Result> results = benchmark(options.roms[i], options);
+        if (options.json)
+            print_json(options.roms[i], results, i + 1 == options.roms.size());
+        else
+            print_table(options.roms[i], results);
+    }
+    if (options.json)
+        printf("  ]\n}\n");
+    return 0;
+}
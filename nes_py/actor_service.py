@@ -0,0 +1,453 @@
+"""A pipeline of native actors stepping environments in pinned processes."""
+import ctypes
+import multiprocessing
+import os
+import sys
+import traceback
+import numpy as np
+from .nes_env import _LIB
+from .nes_env import _RamCondition
+from .nes_env import _RewardTerm
+from .nes_env import _ram_conditions
+from .nes_env import _reward_terms
+from .nes_env import SCREEN_SHAPE_24_BIT
+from .nes_env import SCREEN_SHAPE_32_BIT
+
+
+class _ActorLayout(ctypes.Structure):
+    """The layout of the slots of an actor's queues (ActorLayout in actor.hpp)."""
+    _fields_ = [
+        ('action_slot_size', ctypes.c_uint32),
+        ('actions', ctypes.c_uint32),
+        ('observation_slot_size', ctypes.c_uint32),
+        ('rewards', ctypes.c_uint32),
+        ('infos', ctypes.c_uint32),
+        ('dones', ctypes.c_uint32),
+        ('screens', ctypes.c_uint32),
+        ('terminal_screens', ctypes.c_uint32),
+    ]
+
+
+# setup the argument and return types for SpscQueue_size
+_LIB.SpscQueue_size.argtypes = [ctypes.c_uint32, ctypes.c_uint32]
+_LIB.SpscQueue_size.restype = ctypes.c_size_t
+# setup the argument and return types for SpscQueue_init
+_LIB.SpscQueue_init.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_uint32]
+_LIB.SpscQueue_init.restype = None
+# setup the argument and return types for SpscQueue_count
+_LIB.SpscQueue_count.argtypes = [ctypes.c_void_p]
+_LIB.SpscQueue_count.restype = ctypes.c_uint32
+# setup the argument and return types for SpscQueue_back
+_LIB.SpscQueue_back.argtypes = [ctypes.c_void_p, ctypes.c_int]
+_LIB.SpscQueue_back.restype = ctypes.c_uint32
+# setup the argument and return types for SpscQueue_push
+_LIB.SpscQueue_push.argtypes = [ctypes.c_void_p]
+_LIB.SpscQueue_push.restype = None
+# setup the argument and return types for SpscQueue_front
+_LIB.SpscQueue_front.argtypes = [ctypes.c_void_p, ctypes.c_int]
+_LIB.SpscQueue_front.restype = ctypes.c_uint32
+# setup the argument and return types for SpscQueue_pop
+_LIB.SpscQueue_pop.argtypes = [ctypes.c_void_p]
+_LIB.SpscQueue_pop.restype = None
+# setup the argument and return types for Actor_layout
+_LIB.Actor_layout.argtypes = [ctypes.c_int, ctypes.c_int, ctypes.POINTER(_ActorLayout)]
+_LIB.Actor_layout.restype = None
+# setup the argument and return types for Actor_serve
+_LIB.Actor_serve.argtypes = [
+    ctypes.POINTER(ctypes.c_void_p),
+    ctypes.c_int,
+    ctypes.c_int,
+    ctypes.POINTER(_RewardTerm),
+    ctypes.c_int,
+    ctypes.POINTER(_RamCondition),
+    ctypes.c_int,
+    ctypes.POINTER(_RewardTerm),
+    ctypes.POINTER(ctypes.c_int),
+    ctypes.c_int,
+    ctypes.c_void_p,
+    ctypes.c_void_p,
+]
+_LIB.Actor_serve.restype = None
+
+
+# the command to step the environments of an actor (ActorCommand in actor.hpp)
+_STEP = 0
+# the command to reset the environments of an actor
+_RESET = 1
+# the command to stop an actor
+_CLOSE = 2
+
+
+# the status of a running actor (in the shared status of the actors)
+_RUNNING = 0
+# the status of an actor that raised an exception
+_FAILED = 1
+# the status of an actor that stopped
+_STOPPED = 2
+
+
+# the slot index of a queue wait that timed out (SpscQueue::TIMEOUT)
+_TIMEOUT = 0xFFFFFFFF
+# the milliseconds between checks for dead actors while waiting on them
+_WAIT_TIMEOUT = 100
+
+
+class _Queue(object):
+    """A queue of preallocated slots in shared memory (SpscQueue in spsc_queue.hpp)."""
+
+    def __init__(self, capacity, slot_size):
+        """
+        Allocate and initialize an empty queue.
+
+        Args:
+            capacity (int): the number of slots (a power of two)
+            slot_size (int): the size of a slot in bytes
+
+        Returns:
+            None
+
+        """
+        size = _LIB.SpscQueue_size(capacity, slot_size)
+        # leave room to align the queue to a cache line
+        self._memory = multiprocessing.RawArray(ctypes.c_uint8, size + 64)
+        address = ctypes.addressof(self._memory)
+        self._offset = -address % 64
+        _LIB.SpscQueue_init(self.address, capacity, slot_size)
+
+    @property
+    def address(self):
+        """Return the address of the queue in this process."""
+        return ctypes.addressof(self._memory) + self._offset
+
+    def slots(self):
+        """Return a NumPy view of each slot of the queue (zero-copy)."""
+        address = self.address
+        header = (ctypes.c_uint32 * 48).from_address(address)
+        capacity, slot_size = header[32], header[33]
+        memory = np.frombuffer(self._memory, dtype=np.uint8)
+        # the slots follow the 192-byte header (QueueHeader)
+        start = self._offset + ctypes.sizeof(header)
+        return [memory[start + i * slot_size:start + (i + 1) * slot_size] for i in range(capacity)]
+
+
+def _actor(index, env_fns, core, frames, native, action_queue, observation_queue, status):
+    """
+    Pin the process to a core, create the environments, and serve commands.
+
+    Args:
+        index (int): the index of the actor
+        env_fns (list): the callables to create the environments with
+        core (int): the core to pin the process to, or None to not pin it
+        frames (int): the number of frames of a step
+        native (tuple): the reward terms, done clauses, and info terms
+        action_queue (_Queue): the queue of commands from the learner
+        observation_queue (_Queue): the queue of observations to the learner
+        status (multiprocessing.RawArray): the shared status of the actors
+
+    Returns:
+        None
+
+    """
+    # pin the process before creating the environments so that their memory
+    # is first touched (and allocated) on the NUMA node of the core
+    if core is not None and hasattr(os, 'sched_setaffinity'):
+        os.sched_setaffinity(0, {core})
+    envs = []
+    try:
+        envs = [env_fn() for env_fn in env_fns]
+        reward, done, info = native
+        reward = _reward_terms(reward)
+        done = _ram_conditions(done)
+        info_sizes = (ctypes.c_int * len(info))(*[len(terms) for terms in info])
+        info = _reward_terms([term for terms in info for term in terms])
+        pointers = [env.unwrapped._env for env in envs]
+        pointers = (ctypes.c_void_p * len(envs))(*pointers)
+        _LIB.Actor_serve(pointers, len(envs), frames,
+            reward, len(reward), done, len(done), info, info_sizes, len(info_sizes),
+            action_queue.address, observation_queue.address)
+    except Exception:
+        traceback.print_exc()
+        status[index] = _FAILED
+    finally:
+        if status[index] == _RUNNING:
+            status[index] = _STOPPED
+        for env in envs:
+            env.close()
+
+
+class ActorService(object):
+    """A pipeline of actors stepping environments natively for a learner."""
+
+    def __init__(self, env_fns, num_actors=None, cores=None, depth=2,
+        reward=(), done=(), info=None
+    ):
+        """
+        Create a new actor service.
+
+        Each actor is a process pinned to a core that hosts a chunk of the
+        environments. An actor pulls commands from a lock-free queue in
+        shared memory and steps its environments natively, resetting the
+        episodes that end in place (see `SharedMemoryVectorEnv`). It pushes
+        the observations to another queue. The slots of the queues are
+        allocated up front, so the steady state doesn't allocate memory
+        or take locks. The learner keeps up to `depth` batches in flight
+        for each actor to overlap emulation with inference.
+
+        Args:
+            env_fns (list): callables that each return a new environment
+            num_actors (int): the number of actor processes. defaults to
+                the number of cores available
+            cores (list): the core to pin each actor to. defaults to the
+                cores available to this process in order. None entries
+                don't pin their actor
+            depth (int): the number of batches in flight for each actor (a
+                power of two)
+            reward (list): the terms of the reward (see `NESEnv._rollout`)
+            done (list): the clauses of a RAM predicate (see
+                `NESEnv._run_until`) that ends an episode
+            info (dict): the terms of each info value by its key
+
+        Returns:
+            None
+
+        """
+        if not len(env_fns):
+            raise ValueError('env_fns should contain at least one callable')
+        available = sorted(os.sched_getaffinity(0)) if hasattr(os, 'sched_getaffinity') else [None]
+        if num_actors is None:
+            num_actors = len(available)
+        if not isinstance(num_actors, int):
+            raise TypeError('num_actors must be of type: int')
+        if not num_actors > 0:
+            raise ValueError('num_actors must be > 0')
+        if not isinstance(depth, int):
+            raise TypeError('depth must be of type: int')
+        if depth < 1 or depth & (depth - 1):
+            raise ValueError('depth must be a power of two')
+        self.num_envs = len(env_fns)
+        self.num_actors = min(num_actors, self.num_envs)
+        if cores is None:
+            cores = [available[index % len(available)] for index in range(self.num_actors)]
+        if len(cores) < self.num_actors:
+            raise ValueError('cores should have a core for each actor')
+        info = dict(info or {})
+        self.info_keys = tuple(info)
+        native = (list(reward), list(done), [info[key] for key in self.info_keys])
+        # create a probe environment to determine the spaces
+        env = env_fns[0]()
+        self.observation_space = env.observation_space
+        self.action_space = env.action_space
+        frames = env.unwrapped._frames_per_step
+        env.close()
+        if self.observation_space.shape != SCREEN_SHAPE_24_BIT:
+            raise ValueError('actors need observations of the full screen')
+        self._is_little_endian = sys.byteorder == 'little'
+        # the environments of each actor and the views of their queues
+        self._chunks = np.array_split(np.arange(self.num_envs), self.num_actors)
+        self._actions = []
+        self._observations = []
+        self._procs = []
+        # the status of each actor, so a learner waiting on an actor that
+        # stopped raises instead of blocking (see _RUNNING)
+        self._status = multiprocessing.RawArray(ctypes.c_uint32, self.num_actors)
+        for index, chunk in enumerate(self._chunks):
+            count = len(chunk)
+            layout = _ActorLayout()
+            _LIB.Actor_layout(count, len(self.info_keys), ctypes.byref(layout))
+            action_queue = _Queue(depth, layout.action_slot_size)
+            observation_queue = _Queue(depth, layout.observation_slot_size)
+            self._actions.append((action_queue, [
+                self._action_views(slot, layout, count) for slot in action_queue.slots()
+            ]))
+            self._observations.append((observation_queue, [
+                self._observation_views(slot, layout, count) for slot in observation_queue.slots()
+            ]))
+            start = int(chunk[0])
+            fns = env_fns[start:start + count]
+            args = (index, fns, cores[index], frames, native, action_queue,
+                observation_queue, self._status)
+            proc = multiprocessing.Process(target=_actor, args=args)
+            proc.daemon = True
+            proc.start()
+            self._procs.append(proc)
+
+    @staticmethod
+    def _action_views(slot, layout, count):
+        """Return views of the command, tag, and actions of an action slot."""
+        header = slot[:8].view(np.uint32)
+        return header, slot[layout.actions:layout.actions + count]
+
+    def _observation_views(self, slot, layout, count):
+        """Return views of the fields of an observation slot."""
+        num_info = len(self.info_keys)
+        header = slot[:8].view(np.uint32)
+        rewards = slot[layout.rewards:layout.infos].view(np.float64)
+        infos = slot[layout.infos:layout.dones].view(np.float64).reshape((count, num_info))
+        dones = slot[layout.dones:layout.dones + count].view(np.bool_)
+        shape = (count, ) + SCREEN_SHAPE_32_BIT
+        screens = slot[layout.screens:layout.terminal_screens].reshape(shape)
+        terminals = slot[layout.terminal_screens:layout.observation_slot_size].reshape(shape)
+        return header, self._rgb(screens), rewards, dones, infos, self._rgb(terminals)
+
+    def _rgb(self, screens):
+        """Return a view of 32-bit screens from the emulator as RGB."""
+        if self._is_little_endian:
+            screens = screens[..., ::-1]
+        return screens[..., 1:]
+
+    def _slot(self, actor, wait, queue):
+        """
+        Wait for a slot of a queue of an actor while checking the actor.
+
+        Args:
+            actor (int): the index of the actor
+            wait (callable): SpscQueue_back or SpscQueue_front
+            queue (_Queue): the queue to wait on
+
+        Returns:
+            the index of the slot
+
+        """
+        while True:
+            index = wait(queue.address, _WAIT_TIMEOUT)
+            if index != _TIMEOUT:
+                return index
+            # the actor can't answer once it stops (e.g., if it raised,
+            # crashed, or was killed), so raise instead of blocking
+            if self._status[actor] == _FAILED:
+                raise RuntimeError('actor {} failed'.format(actor))
+            if self._status[actor] == _STOPPED or not self._procs[actor].is_alive():
+                # check for an item the actor published before it stopped
+                index = wait(queue.address, 0)
+                if index != _TIMEOUT:
+                    return index
+                raise RuntimeError('actor {} stopped'.format(actor))
+
+    def send(self, actor, actions=None, tag=0):
+        """
+        Send a batch of actions to an actor, blocking while its queue is full.
+
+        Raises a RuntimeError if the actor stopped (e.g., if it crashed).
+
+        Args:
+            actor (int): the index of the actor
+            actions (iterable): an action for each environment of the actor,
+                or None to reset the environments
+            tag (int): a 32-bit tag returned with the observations
+
+        Returns:
+            None
+
+        """
+        queue, views = self._actions[actor]
+        header, slot = views[self._slot(actor, _LIB.SpscQueue_back, queue)]
+        header[0] = _RESET if actions is None else _STEP
+        header[1] = tag
+        if actions is not None:
+            slot[:] = actions
+        _LIB.SpscQueue_push(queue.address)
+
+    def receive(self, actor):
+        """
+        Wait for the next batch of observations from an actor.
+
+        The arrays are views of a slot of the queue that stay valid until
+        the batch is released with `release`. Raises a RuntimeError if the
+        actor stopped (e.g., if it crashed).
+
+        Args:
+            actor (int): the index of the actor
+
+        Returns:
+            a tuple of:
+            - tag (int): the tag of the batch of actions
+            - observations (np.ndarray): the observation of each environment
+              (the first of the next episode if the episode ended)
+            - rewards (np.ndarray): the reward for each environment
+            - dones (np.ndarray): the done flag for each environment
+            - infos (np.ndarray): the (environments, info keys) info values
+            - terminals (np.ndarray): the last observation of each episode
+              that ended (only valid where dones is set)
+
+        """
+        queue, views = self._observations[actor]
+        index = self._slot(actor, _LIB.SpscQueue_front, queue)
+        header, screens, rewards, dones, infos, terminals = views[index]
+        return int(header[1]), screens, rewards, dones, infos, terminals
+
+    def release(self, actor):
+        """
+        Release the oldest batch of observations from an actor.
+
+        Args:
+            actor (int): the index of the actor
+
+        Returns:
+            None
+
+        """
+        _LIB.SpscQueue_pop(self._observations[actor][0].address)
+
+    def _gather(self):
+        """Receive, copy, and release a batch from every actor."""
+        outputs = []
+        for actor in range(self.num_actors):
+            _, screens, rewards, dones, infos, terminals = self.receive(actor)
+            infos = [dict(zip(self.info_keys, row)) for row in infos]
+            for index in np.flatnonzero(dones):
+                infos[index]['terminal_observation'] = terminals[index].copy()
+            outputs.append((screens.copy(), rewards.copy(), dones.copy(), infos))
+            self.release(actor)
+        observations, rewards, dones, infos = zip(*outputs)
+        infos = [info for chunk in infos for info in chunk]
+        return np.concatenate(observations), np.concatenate(rewards), np.concatenate(dones), infos
+
+    def reset(self):
+        """
+        Reset all the environments and wait for their observations.
+
+        Returns:
+            the observation of each environment
+
+        """
+        for actor in range(self.num_actors):
+            self.send(actor)
+        return self._gather()[0]
+
+    def step(self, actions):
+        """
+        Step all the environments and wait for the outputs.
+
+        Args:
+            actions (iterable): an action for each environment
+
+        Returns:
+            a tuple of the observations, rewards, dones, and infos in the
+            format of `SharedMemoryVectorEnv.step_wait`
+
+        """
+        actions = np.asarray(actions)
+        for actor, chunk in enumerate(self._chunks):
+            self.send(actor, actions[chunk])
+        return self._gather()
+
+    def close(self):
+        """Stop the actors and join their processes."""
+        if self._procs is None:
+            raise ValueError('service has already been closed.')
+        for actor in range(self.num_actors):
+            queue, views = self._actions[actor]
+            try:
+                header, _ = views[self._slot(actor, _LIB.SpscQueue_back, queue)]
+            except RuntimeError:
+                # the actor already stopped
+                continue
+            header[0] = _CLOSE
+            _LIB.SpscQueue_push(queue.address)
+        for proc in self._procs:
+            proc.join()
+        self._procs = None
+
+
+# explicitly define the outward facing API of this module
+__all__ = [ActorService.__name__]
@@ -0,0 +1,106 @@
+"""Deterministic recording and seekable replay of joy-pad inputs."""
+from multiprocessing import Pool
+from .nes_env import _LIB
+
+
+class InputLog(object):
+    """A log of joy-pad inputs with keyframes recorded by an NESEnv."""
+
+    def __init__(self, path):
+        """
+        Read an input log from a file.
+
+        Args:
+            path (str): the path to a file written by NESEnv._stop_recording
+
+        Returns:
+            None
+
+        """
+        self._log = _LIB.InputLog_read(path.encode('utf-8'))
+        if not self._log:
+            raise ValueError('{} is not a valid input log'.format(path))
+
+    @property
+    def frames(self):
+        """Return the number of frames in the log."""
+        return _LIB.InputLog_frames(self._log)
+
+    @property
+    def rom_hash(self):
+        """Return the hash of the ROM the log is for."""
+        return _LIB.InputLog_rom_hash(self._log)
+
+    def close(self):
+        """Close the log."""
+        if self._log is None:
+            raise ValueError('log has already been closed.')
+        _LIB.InputLog_close(self._log)
+        self._log = None
+
+
+def replay(env, log, start=0, stop=None):
+    """
+    Replay the frames of an input log in an environment.
+
+    Args:
+        env (NESEnv): the environment to replay the log in
+        log (InputLog): the input log to replay
+        start (int): the frame to seek to before replaying
+        stop (int): the last frame to replay (defaults to the end)
+
+    Returns:
+        a generator of (frame, screen) for each frame after start
+
+    """
+    if stop is None:
+        stop = log.frames
+    env = env.unwrapped
+    env._seek(log, start)
+    for frame in range(start + 1, stop + 1):
+        # seeking to the next frame simulates exactly one frame
+        env._seek(log, frame)
+        yield frame, env.screen
+
+
+def _replay_worker(args):
+    """Replay an input log in a new environment (for replay_parallel)."""
+    env_fn, path, function = args
+    env = env_fn()
+    log = InputLog(path)
+    try:
+        return function(env, log)
+    finally:
+        log.close()
+        env.close()
+
+
+def replay_parallel(env_fn, paths, function, processes=None):
+    """
+    Replay input logs in parallel worker processes.
+
+    Args:
+        env_fn (callable): a picklable callable that returns a new environment
+        paths (list): the paths of the input logs to replay
+        function (callable): a picklable callable of (env, log) that replays
+            the log (e.g., with `replay`) and returns a picklable result
+        processes (int): the number of processes (defaults to the CPUs)
+
+    Returns:
+        a list with the result of the function for each log
+
+    """
+    pool = Pool(processes)
+    try:
+        return pool.map(_replay_worker, [(env_fn, path, function) for path in paths])
+    finally:
+        pool.close()
+        pool.join()
+
+
+# explicitly define the outward facing API of this module
+__all__ = [
+    InputLog.__name__,
+    replay.__name__,
+    replay_parallel.__name__,
+]
@@ -0,0 +1,63 @@
+#include <algorithm>
+#include "actor.hpp"
+
+namespace Actor {
+    /// the size of a screen with 32-bit pixels in bytes
+    const u32 SCREEN_SIZE = 256 * 240 * 4;
+
+    /// Return an offset rounded up to a multiple of an alignment.
+    inline u32 align(u32 offset, u32 alignment) {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    ActorLayout layout(int count, int info_count) {
+        ActorLayout layout;
+        // the command and the tag come first in both slots
+        layout.actions = 2 * sizeof(u32);
+        layout.action_slot_size = align(layout.actions + count, SpscQueue::LINE);
+        layout.rewards = 2 * sizeof(u32);
+        layout.infos = layout.rewards + count * sizeof(double);
+        layout.dones = layout.infos + count * info_count * sizeof(double);
+        layout.screens = align(layout.dones + count, SpscQueue::LINE);
+        layout.terminal_screens = layout.screens + count * SCREEN_SIZE;
+        layout.observation_slot_size = layout.terminal_screens + count * SCREEN_SIZE;
+        return layout;
+    }
+
+    void serve(NESEnv** envs, int count, int frames, BatchSpec& spec,
+        void* action_queue, void* observation_queue) {
+        SpscQueue actions(action_queue);
+        SpscQueue observations(observation_queue);
+        const ActorLayout slots = layout(count, spec.info.size());
+        while (true) {
+            u8* command = actions.slot(actions.front());
+            u32 code = reinterpret_cast<u32*>(command)[0];
+            if (code == ACTOR_CLOSE) {
+                actions.pop();
+                return;
+            }
+            u8* output = observations.slot(observations.back());
+            // answer with the command and its tag
+            reinterpret_cast<u32*>(output)[0] = code;
+            reinterpret_cast<u32*>(output)[1] = reinterpret_cast<u32*>(command)[1];
+            double* rewards = reinterpret_cast<double*>(output + slots.rewards);
+            double* infos = reinterpret_cast<double*>(output + slots.infos);
+            u8* dones = output + slots.dones;
+            if (code == ACTOR_STEP) {
+                NESEnv::step_batch(envs, count, command + slots.actions, frames,
+                    spec, rewards, dones, infos, output + slots.screens,
+                    output + slots.terminal_screens);
+            } else {
+                std::fill(rewards, rewards + count, 0.0);
+                std::fill(infos, infos + count * spec.info.size(), 0.0);
+                std::fill(dones, dones + count, 0);
+                for (int i = 0; i < count; i++) {
+                    envs[i]->reset();
+                    envs[i]->screen(output + slots.screens + i * SCREEN_SIZE);
+                }
+            }
+            observations.push();
+            actions.pop();
+        }
+    }
+}
@@ -0,0 +1,37 @@
+#include <cstdlib>
+#include "arena.hpp"
+
+#if defined(_WIN32)
+    #include <malloc.h>
+#endif
+
+Arena::Arena(size_t capacity) : capacity(slot(capacity)), used(0) {
+#if defined(_WIN32)
+    block = static_cast<u8*>(_aligned_malloc(this->capacity, ALIGNMENT));
+#else
+    void* memory = nullptr;
+    if (posix_memalign(&memory, ALIGNMENT, this->capacity) != 0)
+        memory = nullptr;
+    block = static_cast<u8*>(memory);
+#endif
+    if (block == nullptr)
+        throw std::bad_alloc();
+}
+
+Arena::~Arena() {
+#if defined(_WIN32)
+    _aligned_free(block);
+#else
+    free(block);
+#endif
+}
+
+void* Arena::allocate(size_t size) {
+    size = slot(size);
+    // the arena is sized up front for everything placed in it
+    if (used + size > capacity)
+        throw std::bad_alloc();
+    void* pointer = block + used;
+    used += size;
+    return pointer;
+}
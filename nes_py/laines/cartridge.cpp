@@ -41,6 +41,14 @@ void Cartridge::signal_scanline() {
     this->mapper->signal_scanline();
 }
 
+void Cartridge::serialize(StateWriter& stream) {
+    this->mapper->serialize(stream);
+}
+
+void Cartridge::deserialize(StateReader& stream) {
+    this->mapper->deserialize(stream);
+}
+
 template <bool wr> u8 Cartridge::access(u16 addr, u8 v) {
     if (!wr) return this->mapper->read(addr);
     else     return this->mapper->write(addr, v);
@@ -0,0 +1,26 @@
+#include <algorithm>
+#include "chr_cache.hpp"
+
+u64 ChrCache::decode_row(u8 low, u8 high, bool flip) {
+    u64 pixels = 0;
+    for (int x = 0; x < 8; x++) {
+        int bit = flip ? x : 7 - x;
+        u64 pixel = (NTH_BIT(high, bit) << 1) | NTH_BIT(low, bit);
+        pixels |= pixel << (8 * x);
+    }
+    return pixels;
+}
+
+void ChrCache::decode(const u8* chr, u32 tile) {
+    const u8* planes = chr + tile * 16;
+    u64* tile_rows = &rows[tile * 16];
+    for (int y = 0; y < 8; y++) {
+        tile_rows[y * 2 + 0] = decode_row(planes[y], planes[y + 8], false);
+        tile_rows[y * 2 + 1] = decode_row(planes[y], planes[y + 8], true);
+    }
+    valid[tile] = true;
+}
+
+void ChrCache::invalidate_all() {
+    std::fill(valid.begin(), valid.end(), false);
+}
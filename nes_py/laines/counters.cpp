@@ -0,0 +1,10 @@
+#include "counters.hpp"
+
+/// the counters for events while no environment is loaded (e.g., loading a ROM)
+static Counters unattributed;
+
+Counters* counters = &unattributed;
+
+void Counters::attach(Counters* owner) {
+    counters = owner != nullptr ? owner : &unattributed;
+}
@@ -6,6 +6,7 @@ namespace CPU {
     u8 ram[0x800];
     u8 read_mem(u16 address) { return ram[address % 0x800]; }
     void write_mem(u16 address, u8 value) { ram[address % 0x800] = value; }
+    const u8* get_ram() { return ram; }
 
     /// the joypad to get input data from
     Joypad* joypad;
@@ -14,9 +15,30 @@ namespace CPU {
 
     /// the cartridge to get game data from
     Cartridge* cartridge;
-    void set_cartridge(Cartridge* new_cartridge) { cartridge = new_cartridge; }
+    void set_cartridge(Cartridge* new_cartridge) { cartridge = new_cartridge; invalidate_prg(); }
     Cartridge* get_cartridge() { return cartridge; }
 
+    /// the PRG-ROM mapped to each 8KB slot of $8000-$FFFF
+    const u8* prg_banks[4];
+    /// whether the slots need to be read from the cartridge again
+    bool prg_stale = true;
+    void invalidate_prg() { prg_stale = true; }
+
+    /// Read the PRG-ROM mapped to the slots from the cartridge.
+    void map_prg_banks() {
+        for (int slot = 0; slot < 4; slot++)
+            prg_banks[slot] = cartridge->prg_bank(slot);
+        prg_stale = false;
+    }
+
+    /// the profiler of the guest code (nullptr when not profiling)
+    Profiler* profiler = nullptr;
+    void set_profiler(Profiler* new_profiler) { profiler = new_profiler; }
+
+    /// the watchpoints on CPU writes (nullptr when not watching)
+    Watchpoints* watchpoints = nullptr;
+    void set_watchpoints(Watchpoints* new_watchpoints) { watchpoints = new_watchpoints; }
+
     /// accumulator, index x, index y, and the stack pointer
     u8 A, X, Y, S;
     /// the program counter for the machine instructions
@@ -36,7 +58,7 @@ namespace CPU {
 
     /* Cycle emulation */
     #define T   tick()
-    inline void tick() { PPU::step(); PPU::step(); PPU::step(); remainingCycles--; }
+    inline void tick() { PPU::step(); PPU::step(); PPU::step(); remainingCycles--; COUNT(cycles); }
 
     /* Flags updating */
     inline void upd_cv(u8 x, u8 y, s16 r) { P[C] = (r>0xFF); P[V] = ~(x^y) & (x^r) & 0x80; }
@@ -48,23 +70,37 @@ namespace CPU {
     void dma_oam(u8 bank);
     template<bool wr> inline u8 access(u16 addr, u8 v = 0) {
         u8* r;
+        // PRG-ROM (reads skip the mapper, which invalidates the slots it remaps)
+        if (!wr && addr >= 0x8000) {
+            COUNT(cartridge_accesses);
+            if (prg_stale)
+                map_prg_banks();
+            return prg_banks[(addr - 0x8000) / 0x2000][addr % 0x2000];
+        }
         // RAM
         if (0x0000 <= addr && addr <= 0x1FFF) {
+            COUNT(ram_accesses);
             r = &ram[addr % 0x800];
-            if (wr)
+            if (wr) {
+                if (watchpoints != nullptr && watchpoints->watching(addr % 0x800))
+                    watchpoints->hit(addr % 0x800, *r, v);
                 *r = v;
+            }
             return *r;
         }
         // PPU
         else if (0x2000 <= addr && addr <= 0x3FFF) {
+            COUNT(ppu_accesses);
             return PPU::access<wr>(addr % 8, v);
         }
         // APU (not implemented, NOP instead)
         else if ((0x4000 <= addr && addr <= 0x4013) || addr == 0x4015) {
+            COUNT(apu_accesses);
             return 1;
         }
         // Joypad 1
         else if (addr == 0x4017) {
+            COUNT(joypad_accesses);
             if (wr)
                 return 1;
             else
@@ -77,6 +113,7 @@ namespace CPU {
         }
         // Joypad Strobe and Joypad 0
         else if (addr == 0x4016) {
+            COUNT(joypad_accesses);
             // Joypad strobe
             if (wr)
                 joypad->write_strobe(v & 1);
@@ -86,6 +123,11 @@ namespace CPU {
         }
         // Cartridge
         else if (0x4018 <= addr && addr <= 0xFFFF) {
+            COUNT(cartridge_accesses);
+            // PRG-RAM (mapper registers can't be watched)
+            if (wr && watchpoints != nullptr && 0x6000 <= addr && addr <= 0x7FFF &&
+                watchpoints->watching(addr))
+                watchpoints->hit(addr, cartridge->access<0>(addr), v);
             return cartridge->access<wr>(addr, v);
         }
 
@@ -187,8 +229,14 @@ namespace CPU {
 
     /* Execute a CPU instruction */
     void exec() {
-        // Fetch the opcode and switch over it
-        switch (rd(PC++)) {
+        COUNT(instructions);
+        // Fetch the opcode
+        u16 pc = PC++;
+        u8 opcode = rd(pc);
+        if (profiler != nullptr && profiler->sample())
+            profiler->record(opcode, pc, pc >= 0x8000 ? cartridge->prg_offset(pc) : 0);
+        // Switch over the opcode
+        switch (opcode) {
             // Select the right function to emulate the instruction:
             case 0x00: return INT<BRK>()  ;  case 0x01: return ORA<izx>()  ;
             case 0x05: return ORA<zp>()   ;  case 0x06: return ASL<zp>()   ;
@@ -297,15 +345,37 @@ namespace CPU {
         remainingCycles += TOTAL_CYCLES;
 
         while (remainingCycles > 0) {
-            if (nmi) INT<NMI>();
-            else if (irq && !P[I]) INT<IRQ>();
+            if (nmi) { COUNT(nmis); INT<NMI>(); }
+            else if (irq && !P[I]) { COUNT(irqs); INT<IRQ>(); }
 
             exec();
         }
     }
 
+    int run_frame(const RamPredicate& predicate) {
+        auto read = [](u16 address) { return ram[address % 0x800]; };
+        int clause = -1;
+        remainingCycles += TOTAL_CYCLES;
+
+        while (remainingCycles > 0) {
+            if (nmi) { COUNT(nmis); INT<NMI>(); }
+            else if (irq && !P[I]) { COUNT(irqs); INT<IRQ>(); }
+
+            exec();
+            if (clause < 0)
+                clause = predicate.test(read);
+        }
+        return clause;
+    }
+
     CPUState* get_state() {
         CPUState* state = new CPUState();
+        get_state(state);
+        return state;
+    }
+
+    void get_state(CPUState* state) {
+        COUNT_N(snapshot_bytes, sizeof(CPUState));
         // copy the RAM array into the CPU state
         std::copy(std::begin(ram), std::end(ram), std::begin(state->ram));
         // copy the registers
@@ -320,11 +390,12 @@ namespace CPU {
         // copy the interrupt flags
         state->nmi = nmi;
         state->irq = irq;
-
-        return state;
+        // copy the cycle counter
+        state->remainingCycles = remainingCycles;
     }
 
     void set_state(CPUState* state) {
+        COUNT_N(snapshot_bytes, sizeof(CPUState));
         // copy the RAM array into the CPU state
         std::copy(std::begin(state->ram), std::end(state->ram), std::begin(ram));
         // copy the registers
@@ -339,5 +410,7 @@ namespace CPU {
         // copy the interrupt flags
         nmi = state->nmi;
         irq = state->irq;
+        // copy the cycle counter
+        remainingCycles = state->remainingCycles;
     }
 }
@@ -1,32 +1,19 @@
 #include "gamestate.hpp"
 
-GameState::GameState() {
-    ppu_state = new PPUState();
-    cpu_state = new CPUState();
-};
+GameState::GameState(CPUState* cpu_state, PPUState* ppu_state, Joypad* joypad) :
+    cartridge(nullptr), joypad(joypad), ppu_state(ppu_state), cpu_state(cpu_state) { }
 
 GameState::~GameState() {
+    // the states and joy-pad belong to the storage of the environment
     delete cartridge;
-    delete joypad;
-    delete gui;
-    delete ppu_state;
-    delete cpu_state;
 }
 
-GameState::GameState(GameState* state) {
-    cartridge = new Cartridge(state->cartridge);
-    joypad = new Joypad(state->joypad);
-    gui = new GUI(state->gui);
-    cpu_state = new CPUState(state->cpu_state);
-    ppu_state = new PPUState(state->ppu_state);
-}
-
-GameState::GameState(GameState* state, CPUState* cpu, PPUState* ppu) {
-    cartridge = new Cartridge(state->cartridge);
-    joypad = new Joypad(state->joypad);
-    gui = new GUI(state->gui);
-    cpu_state = cpu;
-    ppu_state = ppu;
+void GameState::copy(GameState* state) {
+    *cpu_state = *state->cpu_state;
+    *ppu_state = *state->ppu_state;
+    *joypad = *state->joypad;
+    cartridge->assign(state->cartridge);
+    COUNT_N(snapshot_bytes, sizeof(Joypad) + sizeof(CPUState) + sizeof(PPUState));
 }
 
 void GameState::load() {
@@ -36,6 +23,31 @@ void GameState::load() {
     CPU::set_joypad(joypad);
     // set the PPU up
     PPU::set_state(ppu_state);
-    PPU::set_gui(gui);
     PPU::set_cartridge(cartridge);
 }
+
+void GameState::save() {
+    // copy the CPU and PPU variables into the existing states
+    CPU::get_state(cpu_state);
+    PPU::get_state(ppu_state);
+}
+
+void GameState::serialize(StateWriter& stream) {
+    cpu_state->serialize(stream);
+    ppu_state->serialize(stream);
+    cartridge->serialize(stream);
+    joypad->serialize(stream);
+}
+
+size_t GameState::footprint() {
+    return sizeof(GameState) + sizeof(CPUState) + sizeof(PPUState) +
+        sizeof(Joypad) + cartridge->footprint();
+}
+
+bool GameState::deserialize(StateReader& stream) {
+    cpu_state->deserialize(stream);
+    ppu_state->deserialize(stream);
+    cartridge->deserialize(stream);
+    joypad->deserialize(stream);
+    return stream.good();
+}
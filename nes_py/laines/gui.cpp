@@ -1,11 +1,14 @@
 #include "gui.hpp"
 
 GUI::GUI() {
-
+    // start with a black screen until the first frame is rendered
+    memset(pixels, 0, WIDTH * HEIGHT * sizeof(u32));
+    memset(screen, 0, WIDTH * HEIGHT * sizeof(u32));
 };
 
 GUI::GUI(GUI* gui) {
-    // copy the screen from the other GUI into this GUI
+    // copy the video buffer and the screen from the other GUI into this GUI
+    memcpy(pixels, gui->pixels, WIDTH * HEIGHT * sizeof(u32));
     memcpy(screen, gui->screen, WIDTH * HEIGHT * sizeof(u32));
 };
 
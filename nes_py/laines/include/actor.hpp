@@ -0,0 +1,71 @@
+#pragma once
+#include "nes_env.hpp"
+#include "spsc_queue.hpp"
+
+/// The commands to an actor (the first word of a slot of its action queue)
+enum ActorCommand {
+    /// step the environments with the actions of the slot
+    ACTOR_STEP,
+    /// reset the environments
+    ACTOR_RESET,
+    /// stop serving commands
+    ACTOR_CLOSE
+};
+
+/**
+    The layout of the slots of the queues of an actor (laid out for the
+    Python API). A slot of the action queue is the command, a tag, and an
+    action for each environment. A slot of the observation queue is the
+    command and tag it answers, then the rewards, info values, done flags,
+    screens, and the last screens of the episodes that ended.
+*/
+struct ActorLayout {
+    /// the size of a slot of the action queue in bytes
+    u32 action_slot_size;
+    /// the offset of the actions (u8) in a slot of the action queue
+    u32 actions;
+    /// the size of a slot of the observation queue in bytes
+    u32 observation_slot_size;
+    /// the offset of the rewards (double)
+    u32 rewards;
+    /// the offset of the (environments, info values) info values (double)
+    u32 infos;
+    /// the offset of the done flags (u8)
+    u32 dones;
+    /// the offset of the 32-bit screens (aligned to a cache line)
+    u32 screens;
+    /// the offset of the 32-bit last screens of the episodes that ended
+    u32 terminal_screens;
+};
+
+/**
+    An actor that steps a batch of environments for a learner, e.g., in a
+    worker process pinned to a core. Commands and observations pass through
+    queues in shared memory with preallocated slots, so serving commands
+    doesn't allocate memory or wait on mutexes held by other processes.
+*/
+namespace Actor {
+    /**
+        Return the layout of the slots of the queues of an actor.
+
+        @param count the number of environments of the actor
+        @param info_count the number of info values of a step
+        @returns the sizes of the slots and the offsets of their fields
+    */
+    ActorLayout layout(int count, int info_count);
+
+    /**
+        Serve commands from an action queue until a close command. Each
+        command is answered in the observation queue (see ActorLayout).
+        Steps reset the episodes that end in place (see NESEnv::step_batch).
+
+        @param envs the environments of the actor
+        @param count the number of environments
+        @param frames the number of frames of a step
+        @param spec the reward, done predicate, and info values of the steps
+        @param action_queue the memory of the action queue (see SpscQueue)
+        @param observation_queue the memory of the observation queue
+    */
+    void serve(NESEnv** envs, int count, int frames, BatchSpec& spec,
+        void* action_queue, void* observation_queue);
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "common.hpp"
+
+/**
+    A block of memory that objects are laid out in back to back, each
+    starting on its own cache line. The objects are placed once and live
+    as long as the arena, so reusing them never calls malloc. Only objects
+    without destructors can be placed (the block is freed all at once).
+*/
+class Arena {
+private:
+    /// the block of memory
+    u8* block;
+    /// the size of the block in bytes
+    size_t capacity;
+    /// the number of bytes of the block in use
+    size_t used;
+
+public:
+    /// the alignment of the block and of each object in it (a cache line)
+    static const size_t ALIGNMENT = 64;
+
+    /// Return the bytes an object of a size takes up in an arena.
+    static size_t slot(size_t size) {
+        return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+    /// Return the bytes an object of a type takes up in an arena.
+    template<typename T> static size_t slot() { return slot(sizeof(T)); }
+
+    /**
+        Initialize a new arena.
+
+        @param capacity the size of the block in bytes
+    */
+    explicit Arena(size_t capacity);
+
+    /// Free the block of the arena.
+    ~Arena();
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    /**
+        Return the next slot of the arena.
+
+        @param size the size of the slot in bytes
+        @returns a pointer to the cache-aligned slot
+    */
+    void* allocate(size_t size);
+
+    /**
+        Place a new object in the next slot of the arena.
+
+        @param args the arguments to construct the object with
+        @returns a pointer to the object
+    */
+    template<typename T, typename... Args> T* make(Args&&... args) {
+        static_assert(std::is_trivially_destructible<T>::value,
+            "arena objects are never destroyed");
+        return new (allocate(sizeof(T))) T(std::forward<Args>(args)...);
+    }
+
+    /// Return the size of the block in bytes.
+    size_t size() { return capacity; }
+};
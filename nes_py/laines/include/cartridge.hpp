@@ -19,15 +19,51 @@ public:
     /// Initialize a cartridge as a copy of another
     Cartridge(Cartridge* cart);
 
+    /// Copy the state of a cartridge of the same ROM into this one
+    void assign(Cartridge* cart) { mapper->assign(cart->mapper); }
+
     /// Delete an instance of cartridge
     ~Cartridge();
 
     /// Signal a scanline to the mapper for this cartridge.
     void signal_scanline();
 
+    /// Return the offset in PRG-ROM that an address in $8000-$FFFF maps to
+    u32 prg_offset(u16 addr) { return mapper->prg_offset(addr); }
+
+    /// Return the PRG-ROM mapped to an 8KB slot of $8000-$FFFF
+    const u8* prg_bank(int slot) { return mapper->prg_bank(slot); }
+
+    /// Return the size of the PRG-ROM in bytes
+    u32 prg_size() { return mapper->prg_size(); }
+
+    /// Return the hash of the ROM
+    u64 rom_hash() { return mapper->rom_hash(); }
+
+    /// Return the PRG RAM of the cartridge
+    const u8* prg_ram() { return mapper->prg_ram(); }
+
+    /// Return the size of the PRG RAM in bytes
+    u32 prg_ram_size() { return mapper->prg_ram_size(); }
+
+    /// Return the size of the memory of this cartridge in bytes
+    size_t footprint() { return sizeof(Cartridge) + mapper->footprint(); }
+
+    /// Return the size of the memory shared by the copies of this cartridge
+    size_t shared_footprint() { return mapper->shared_footprint(); }
+
     /// PRG-ROM access
     template <bool wr> u8 access(u16 addr, u8 v = 0);
 
+    /// Return 8 decoded pixels of the CHR row whose low plane is at addr
+    u64 chr_pixels(u16 addr, bool flip) { return mapper->chr_pixels(addr, flip); }
+
     /// CHR-ROM/RAM access
     template <bool wr> u8 chr_access(u16 addr, u8 v = 0);
+
+    /// Write the mapper state to a state stream
+    void serialize(StateWriter& stream);
+
+    /// Read the mapper state from a state stream
+    void deserialize(StateReader& stream);
 };
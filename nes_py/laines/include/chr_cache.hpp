@@ -0,0 +1,66 @@
+#pragma once
+#include <vector>
+#include "common.hpp"
+
+/**
+    A cache of CHR tiles decoded from bit planes into rows of pixels. A row
+    is a 64-bit value with one byte per pixel (0-3), leftmost pixel in the
+    lowest byte, so a renderer gets 8 pixels with one load. Each row is
+    also cached horizontally flipped. Tiles are decoded on first use.
+*/
+class ChrCache {
+private:
+    /// the decoded rows of each tile (8 rows of normal and flipped pixels)
+    std::vector<u64> rows;
+    /// whether each tile has been decoded since it last changed
+    std::vector<bool> valid;
+
+    /// Decode a tile from CHR memory into the cache.
+    void decode(const u8* chr, u32 tile);
+
+public:
+    /**
+        Initialize a new cache with no decoded tiles.
+
+        @param chr_size the size of the CHR memory in bytes
+    */
+    ChrCache(u32 chr_size) : rows(chr_size, 0), valid(chr_size / 16, false) { }
+
+    /**
+        Decode a row of 8 pixels from its two bit planes.
+
+        @param low the low bit plane of the row
+        @param high the high bit plane of the row
+        @param flip whether to flip the row horizontally
+        @returns the pixels of the row, one byte per pixel
+    */
+    static u64 decode_row(u8 low, u8 high, bool flip);
+
+    /**
+        Return a decoded row of a tile.
+
+        @param chr the CHR memory the cache decodes
+        @param offset the offset in CHR memory of the row's low bit plane
+        @param flip whether to return the row flipped horizontally
+        @returns the pixels of the row, one byte per pixel
+    */
+    inline u64 row(const u8* chr, u32 offset, bool flip) {
+        u32 tile = offset / 16;
+        if (!valid[tile])
+            decode(chr, tile);
+        return rows[(tile * 8 + offset % 8) * 2 + flip];
+    }
+
+    /**
+        Invalidate the tile of a byte of CHR memory after a write.
+
+        @param offset the offset of the written byte in CHR memory
+    */
+    inline void invalidate(u32 offset) { valid[offset / 16] = false; }
+
+    /// Invalidate every tile (e.g., after loading CHR RAM from a state).
+    void invalidate_all();
+
+    /// Return the size of the decoded tiles in bytes.
+    size_t footprint() { return rows.size() * sizeof(u64) + valid.size() / 8; }
+};
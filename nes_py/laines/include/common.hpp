@@ -3,8 +3,30 @@
 
 #define NTH_BIT(x, n) (((x) >> (n)) & 1)
 
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#endif
+
 /* Integer type shortcuts */
 typedef uint8_t  u8;  typedef int8_t  s8;
 typedef uint16_t u16; typedef int16_t s16;
 typedef uint32_t u32; typedef int32_t s32;
 typedef uint64_t u64; typedef int64_t s64;
+
+/// Return the index of the lowest set bit of a non-zero value.
+inline int lowest_bit(u64 x) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return index;
+#else
+    return __builtin_ctzll(x);
+#endif
+}
+
+/// Return the 64-bit FNV-1a hash of an array of bytes.
+inline u64 hash_bytes(const u8* bytes, u64 size, u64 hash = 0xCBF29CE484222325ull) {
+    for (u64 i = 0; i < size; i++)
+        hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+    return hash;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "common.hpp"
+
+/**
+    Counters of hardware events in the emulator. The counters are only
+    updated when compiled with NES_COUNTERS defined (e.g., `scons
+    counters=1`), otherwise the COUNT macros compile to nothing.
+*/
+struct Counters {
+    /// the number of CPU instructions executed
+    u64 instructions;
+    /// the number of CPU cycles emulated
+    u64 cycles;
+    /// the number of visible PPU dots written to the video buffer
+    u64 dots_rendered;
+    /// the number of visible PPU dots skipped with output disabled
+    u64 dots_skipped;
+    /// the number of CPU bus accesses to RAM ($0000-$1FFF)
+    u64 ram_accesses;
+    /// the number of CPU bus accesses to PPU registers ($2000-$3FFF)
+    u64 ppu_accesses;
+    /// the number of CPU bus accesses to APU registers ($4000-$4013, $4015)
+    u64 apu_accesses;
+    /// the number of CPU bus accesses to the joy-pads ($4016-$4017)
+    u64 joypad_accesses;
+    /// the number of CPU bus accesses to the cartridge ($4018-$FFFF)
+    u64 cartridge_accesses;
+    /// the number of writes to mapper registers
+    u64 mapper_writes;
+    /// the number of times a mapper applied its registers (re-banked)
+    u64 mapper_applies;
+    /// the number of non-mask-able interrupts serviced
+    u64 nmis;
+    /// the number of interrupt requests serviced
+    u64 irqs;
+    /// the number of bytes copied for game-states and state snapshots
+    u64 snapshot_bytes;
+
+    /**
+        Direct the counting in the machine to a set of counters.
+
+        @param owner the counters to update, or nullptr to stop attributing
+        events to an environment
+    */
+    static void attach(Counters* owner);
+};
+
+/// the counters of the environment loaded into the machine
+extern Counters* counters;
+
+#ifdef NES_COUNTERS
+    /// whether the counters are compiled in
+    #define COUNTERS_ENABLED true
+    /// Increment a counter by one.
+    #define COUNT(field) (counters->field++)
+    /// Increment a counter by a number of events.
+    #define COUNT_N(field, n) (counters->field += (n))
+#else
+    #define COUNTERS_ENABLED false
+    #define COUNT(field) ((void) 0)
+    #define COUNT_N(field, n) ((void) sizeof(n))
+#endif
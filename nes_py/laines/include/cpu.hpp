@@ -3,8 +3,13 @@
 #include <cstring>
 #include <iostream>
 #include "common.hpp"
+#include "counters.hpp"
+#include "profiler.hpp"
+#include "ram_predicate.hpp"
+#include "watchpoints.hpp"
 #include "joypad.hpp"
 #include "cartridge.hpp"
+#include "state_stream.hpp"
 
 /* Processor flags */
 enum Flag {C, Z, I, D, V, N};
@@ -53,13 +58,17 @@ struct CPUState {
     Flags P;
     /// non-mask-able interrupt and interrupt request flag
     bool nmi, irq;
+    /// the remaining clock cycles in the current frame
+    int remainingCycles;
 
     /// Initialize a new CPU State
     CPUState() {
         P.set(0x04);
         A = X = Y = S = 0x00;
+        PC = 0x0000;
         memset(ram, 0xFF, sizeof(ram));
         nmi = irq = false;
+        remainingCycles = 0;
     }
 
     /// Initialize a new CPU State as a copy of another
@@ -78,6 +87,29 @@ struct CPUState {
         // copy the interrupt flags
         nmi = state->nmi;
         irq = state->irq;
+        // copy the cycle counter
+        remainingCycles = state->remainingCycles;
+    }
+
+    /// Write the CPU state to a state stream
+    void serialize(StateWriter& stream) {
+        stream.write(ram, sizeof(ram));
+        stream.write(A); stream.write(X); stream.write(Y); stream.write(S);
+        stream.write(PC);
+        stream.write(P.get());
+        stream.write(nmi); stream.write(irq);
+        stream.write(remainingCycles);
+    }
+
+    /// Read the CPU state from a state stream
+    void deserialize(StateReader& stream) {
+        stream.read(ram, sizeof(ram));
+        A = stream.read<u8>(); X = stream.read<u8>();
+        Y = stream.read<u8>(); S = stream.read<u8>();
+        PC = stream.read<u16>();
+        P.set(stream.read<u8>());
+        nmi = stream.read<bool>(); irq = stream.read<bool>();
+        remainingCycles = stream.read<int>();
     }
 };
 
@@ -109,6 +141,27 @@ namespace CPU {
     /// Return the pointer to this PPU's Cartridge instance
     Cartridge* get_cartridge();
 
+    /**
+        Mark the PRG-ROM slots the CPU reads code and data from as stale,
+        e.g., after a mapper maps another bank. The slots are read from the
+        cartridge again on the next read from $8000-$FFFF.
+    */
+    void invalidate_prg();
+
+    /**
+        Set the profiler to record executed instructions with.
+
+        @param new_profiler the profiler to use, or nullptr to not profile
+    */
+    void set_profiler(Profiler* new_profiler);
+
+    /**
+        Set the watchpoints to check CPU writes with.
+
+        @param new_watchpoints the watchpoints to use, or nullptr to not watch
+    */
+    void set_watchpoints(Watchpoints* new_watchpoints);
+
     /**
         Return the value of the given memory address.
         This is meant as a public getter to the memory of the machine for RAM hacks.
@@ -129,6 +182,9 @@ namespace CPU {
     */
     void write_mem(u16 address, u8 value);
 
+    /// Return the 2KB RAM of the machine.
+    const u8* get_ram();
+
     /**
         Set the non-maskable interrupt flag.
 
@@ -149,9 +205,21 @@ namespace CPU {
     /// Run the CPU for roughly a frame
     void run_frame();
 
+    /**
+        Run the CPU for roughly a frame, testing a predicate on the RAM after
+        each instruction. The frame always runs to the end.
+
+        @param predicate the predicate to test
+        @returns the first clause of the predicate that held, or -1
+    */
+    int run_frame(const RamPredicate& predicate);
+
     /// Return a new CPU state of the CPU variables
     CPUState* get_state();
 
+    /// Copy the CPU variables into an existing CPU state
+    void get_state(CPUState* state);
+
     /// Restore the CPU variables from a saved state
     void set_state(CPUState* state);
 }
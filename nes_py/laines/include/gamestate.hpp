@@ -1,5 +1,5 @@
+#pragma once
 #include "cartridge.hpp"
-#include "gui.hpp"
 #include "joypad.hpp"
 #include "cpu.hpp"
 #include "ppu.hpp"
@@ -11,21 +11,31 @@ public:
     Cartridge* cartridge;
     /// the joy-pad for the game-state
     Joypad* joypad;
-    /// the GUI for the game-state
-    GUI* gui;
-    /// the state for the CPU
+    /// the state for the PPU
     PPUState* ppu_state;
-    /// the state for the GPU
+    /// the state for the CPU
     CPUState* cpu_state;
 
-    /// Initialize a new game-state
-    GameState();
-    /// Delete a game-state
+    /**
+        Initialize a new game-state from storage owned by the caller.
+
+        @param cpu_state the storage for the CPU state
+        @param ppu_state the storage for the PPU state
+        @param joypad the storage for the joy-pad
+    */
+    GameState(CPUState* cpu_state, PPUState* ppu_state, Joypad* joypad);
+    /// Delete a game-state (and its cartridge)
     ~GameState();
-    /// create a new game-state as a copy of another
-    GameState(GameState* state);
-    /// create a new game-state as a copy of another with different states
-    GameState(GameState* state, CPUState* new_cpu_state, PPUState* new_ppu_state);
+    /// Copy another game-state of the same ROM into this one (no allocations)
+    void copy(GameState* state);
     /// Load the game-state's data into the machine
     void load();
+    /// Save the machine's data into the game-state
+    void save();
+    /// Write the game-state to a state stream
+    void serialize(StateWriter& stream);
+    /// Read the game-state from a state stream, return false if truncated
+    bool deserialize(StateReader& stream);
+    /// Return the size of the memory of the game-state in bytes
+    size_t footprint();
 };
@@ -3,7 +3,12 @@
 #include <cstring>
 #include "common.hpp"
 
-/// an abstraction of a GUI for copying screens to a high-level client.
+/**
+    an abstraction of a GUI for copying screens to a high-level client. The
+    GUI is the framebuffer of an environment: the video buffer the PPU
+    draws the next frame in and the screen of the last complete frame. It
+    isn't part of the game-state, so snapshots stay compact.
+*/
 class GUI {
 private:
     /// the width of the screen in pixels
@@ -12,6 +17,9 @@ private:
     /// the height of the screen in pixels
     static const unsigned HEIGHT = 240;
 
+    /// the video buffer the PPU draws the next frame in
+    u32 pixels[HEIGHT * WIDTH];
+
     /// the pixels representing a frame (the screen)
     u32 screen[HEIGHT][WIDTH];
 
@@ -28,6 +36,9 @@ public:
     /// Return the height of the screen.
     static unsigned get_height();
 
+    /// Return the video buffer the PPU draws the next frame in.
+    u32* video_buffer() { return pixels; }
+
     /**
         Copy the pixels to the local screen memory.
 
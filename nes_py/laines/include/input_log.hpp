@@ -0,0 +1,103 @@
+#pragma once
+#include <vector>
+#include "common.hpp"
+#include "state_stream.hpp"
+
+/// A snapshot of the serialized machine state in an input log.
+struct Keyframe {
+    /// the number of frames in the log before the snapshot
+    u32 frame;
+    /// the serialized state of the machine
+    std::vector<u8> state;
+};
+
+/**
+    A log of joy-pad inputs (one byte per frame per port) with periodic
+    keyframes of the machine state to seek from.
+*/
+class InputLog {
+private:
+    /// the buttons of each port for each frame
+    std::vector<u8> inputs;
+    /// the keyframes in increasing order of frame
+    std::vector<Keyframe> keyframes;
+    /// the number of frames between periodic keyframes
+    u32 keyframe_interval;
+    /// the hash of the ROM the log is for
+    u64 rom_hash;
+
+public:
+    /// the number of joy-pad ports recorded for each frame
+    static const int NUM_PORTS = 2;
+
+    /**
+        Initialize a new empty input log.
+
+        @param keyframe_interval the number of frames between keyframes
+        @param rom_hash the hash of the ROM the log is for
+    */
+    InputLog(u32 keyframe_interval, u64 rom_hash);
+
+    /// Return the number of frames in the log.
+    u32 get_frames();
+
+    /// Return the number of frames between periodic keyframes.
+    u32 get_keyframe_interval();
+
+    /// Return the hash of the ROM the log is for.
+    u64 get_rom_hash();
+
+    /**
+        Return the buttons pressed on a port during a frame.
+
+        @param frame the index of the frame in the log
+        @param port the joy-pad port. 0 for player 1, 1 for player 2
+    */
+    u8 get_buttons(u32 frame, int port);
+
+    /**
+        Append the buttons of all ports for a new frame.
+
+        @param buttons the bitmap of pressed buttons for each port
+    */
+    void append(const u8* buttons);
+
+    /**
+        Add a keyframe of the state before the next appended frame.
+
+        @param state the serialized state of the machine
+    */
+    void add_keyframe(std::vector<u8>& state);
+
+    /**
+        Return the last keyframe at or before a frame.
+
+        @param frame the index of the frame to seek to
+        @returns a pointer to the keyframe or nullptr if there is none
+    */
+    const Keyframe* nearest_keyframe(u32 frame);
+
+    /**
+        Return the keyframe exactly at a frame.
+
+        @param frame the index of the frame
+        @returns a pointer to the keyframe or nullptr if there is none
+    */
+    const Keyframe* keyframe_at(u32 frame);
+
+    /**
+        Write the log to a file.
+
+        @param path the path of the file to write
+        @returns true if the file was written
+    */
+    bool write(const char* path);
+
+    /**
+        Read a log from a file.
+
+        @param path the path of the file to read
+        @returns a new input log or nullptr if the file is invalid
+    */
+    static InputLog* read(const char* path);
+};
@@ -1,6 +1,7 @@
 #pragma once
 #include <iostream>
 #include "common.hpp"
+#include "state_stream.hpp"
 
 /// A joy-pad abstraction for handling virtual button presses
 class Joypad {
@@ -31,6 +32,14 @@ public:
     */
     void write_buttons(int n, u8 buttons);
 
+    /**
+        Return the button state of the given joy-pad.
+
+        @param n the joy-pad to address. 0 for player 1, 1 for player 2
+        @returns the bitmap of pressed buttons on the controller
+    */
+    u8 get_buttons(int n);
+
     /**
         Read joy-pad state (NES register format).
 
@@ -45,4 +54,10 @@ public:
         @param v whether strobe is enabled (true) or disabled (false)
     */
     void write_strobe(bool v);
+
+    /// Write the joy-pad state to a state stream
+    void serialize(StateWriter& stream);
+
+    /// Read the joy-pad state from a state stream
+    void deserialize(StateReader& stream);
 };
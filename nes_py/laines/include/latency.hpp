@@ -0,0 +1,142 @@
+#pragma once
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include "common.hpp"
+
+/**
+    A histogram of latencies in nanoseconds with log-linear buckets (like
+    an HDR histogram). Each power of two is split into 32 buckets, so
+    percentiles are within ~3% of the recorded values.
+*/
+class LatencyHistogram {
+private:
+    /// the number of bits of precision below the leading bit of a value
+    static const int SUB_BUCKET_BITS = 5;
+    /// the number of buckets in each power of two
+    static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    /// the largest power of two tracked (longer latencies are clamped)
+    static const int MAX_EXPONENT = 40;
+    /// the total number of buckets
+    static const int BUCKETS = (MAX_EXPONENT - SUB_BUCKET_BITS + 2) * SUB_BUCKETS;
+
+    /// the number of recorded values in each bucket
+    u64 counts[BUCKETS];
+    /// the number of recorded values
+    u64 total;
+    /// the sum of the recorded values
+    u64 sum;
+    /// the largest recorded value
+    u64 maximum;
+
+    /// Return the bucket of a value.
+    static int bucket(u64 value);
+
+    /// Return the value in the middle of a bucket.
+    static u64 midpoint(int index);
+
+public:
+    /// Initialize a new empty histogram.
+    LatencyHistogram() { reset(); }
+
+    /// Remove all the recorded values.
+    void reset();
+
+    /**
+        Record a latency.
+
+        @param nanoseconds the latency to record
+    */
+    void record(u64 nanoseconds) {
+        counts[bucket(nanoseconds)]++;
+        total++;
+        sum += nanoseconds;
+        if (nanoseconds > maximum)
+            maximum = nanoseconds;
+    }
+
+    /// Return the number of recorded values.
+    u64 count() { return total; }
+
+    /// Return the mean of the recorded values in nanoseconds.
+    double mean() { return total ? static_cast<double>(sum) / total : 0; }
+
+    /// Return the largest recorded value in nanoseconds.
+    u64 max() { return maximum; }
+
+    /**
+        Return the value at a percentile.
+
+        @param percent the percentile in [0, 100] (e.g., 99.9)
+        @returns the latency in nanoseconds, or 0 if there are no values
+    */
+    u64 percentile(double percent);
+};
+
+/// An operation of an environment with a latency histogram.
+enum LatencyOp { STEP, BACKUP, RESTORE, SCREEN, NUM_LATENCY_OPS };
+
+/**
+    A timeline of the operations of all environments in the Chrome
+    trace-event format (chrome://tracing or https://ui.perfetto.dev).
+*/
+namespace Trace {
+    /// Start recording a new timeline (discarding any previous one).
+    void start();
+
+    /**
+        Stop recording and write the timeline to a JSON file.
+
+        @param path the path of the file to write, or nullptr to discard
+        @returns true if the file was written
+    */
+    bool stop(const char* path);
+
+    /// Return true if a timeline is being recorded.
+    bool enabled();
+
+    /**
+        Record a finished operation on the calling thread.
+
+        @param op the operation
+        @param env the identifier of the environment
+        @param start the time the operation started
+        @param end the time the operation ended
+    */
+    void record(LatencyOp op, u32 env,
+        std::chrono::steady_clock::time_point start,
+        std::chrono::steady_clock::time_point end);
+}
+
+/// A timer that records the lifetime of a scope as an operation's latency.
+class LatencyTimer {
+private:
+    /// the histogram to record the latency in
+    LatencyHistogram& histogram;
+    /// the operation being timed
+    LatencyOp op;
+    /// the identifier of the environment
+    u32 env;
+    /// the time the scope started
+    std::chrono::steady_clock::time_point start;
+
+public:
+    /**
+        Start timing an operation.
+
+        @param histogram the histogram to record the latency in
+        @param op the operation being timed
+        @param env the identifier of the environment
+    */
+    LatencyTimer(LatencyHistogram& histogram, LatencyOp op, u32 env) :
+        histogram(histogram), op(op), env(env),
+        start(std::chrono::steady_clock::now()) { }
+
+    /// Record the latency of the operation.
+    ~LatencyTimer() {
+        auto end = std::chrono::steady_clock::now();
+        histogram.record(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+        if (Trace::enabled())
+            Trace::record(op, env, start, end);
+    }
+};
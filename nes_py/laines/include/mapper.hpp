@@ -1,16 +1,31 @@
 #pragma once
 #include <iostream>
 #include <cstring>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include "common.hpp"
+#include "chr_cache.hpp"
+#include "counters.hpp"
+#include "state_stream.hpp"
 
 /// An abstract base class for a Mapper module on a Cartridge
 class Mapper {
-    /// the ROM this mapper is loading from
-    u8* rom;
+    /// the ROM this mapper is loading from (shared by its copies)
+    std::shared_ptr<u8> rom;
     /// the size of the ROM in bytes
     int romSize;
     /// whether this mapper has CHR RAM
     bool chrRam = false;
+    /// the hash of the ROM (to check states are for this ROM)
+    u64 romHash;
+    /// the decoded CHR-ROM tiles of each ROM by hash (shared by its mappers)
+    static std::unordered_map<u64, std::weak_ptr<ChrCache>> romCaches;
+    /// the lock on the decoded CHR-ROM tiles of each ROM
+    static std::mutex romCachesLock;
+
+    /// Return the decoded tiles shared by every mapper of a CHR-ROM
+    static std::shared_ptr<ChrCache> rom_cache(u64 hash, u32 size);
 
 protected:
     u32 prgMap[4];
@@ -19,21 +34,73 @@ protected:
     u8 *prg, *chr, *prgRam;
     u32 prgSize, chrSize, prgRamSize;
 
+    /// the decoded CHR tiles (shared by every mapper of a CHR-ROM, null
+    /// until the first render for CHR RAM)
+    std::shared_ptr<ChrCache> chrCache;
+
+    /// Return the decoded CHR tiles, creating the cache of CHR RAM if needed
+    ChrCache* cache() {
+        if (chrCache == nullptr)
+            chrCache = std::make_shared<ChrCache>(chrSize);
+        return chrCache.get();
+    }
+
     template <int pageKBs> void map_prg(int slot, int bank);
     template <int pageKBs> void map_chr(int slot, int bank);
 
+    /// Write a byte of CHR RAM (writes to CHR-ROM are ignored)
+    u8 write_chr(u16 addr, u8 v);
+
+private:
+    /// Allocate the block of PRG RAM and CHR RAM (if any) of the mapper
+    void allocate_ram();
+
 public:
     Mapper() { };
     Mapper(u8* rom);
     Mapper(Mapper* mapper);
     virtual Mapper* copy();
+    /// Copy the state of a mapper of the same ROM into this one (no allocations)
+    virtual void assign(Mapper* mapper);
     virtual ~Mapper();
 
     u8 read(u16 addr);
+
+    /// Return the offset in PRG-ROM that an address in $8000-$FFFF maps to
+    u32 prg_offset(u16 addr) {
+        return prgMap[(addr - 0x8000) / 0x2000] + ((addr - 0x8000) % 0x2000);
+    }
+    /// Return the PRG-ROM mapped to an 8KB slot of $8000-$FFFF
+    const u8* prg_bank(int slot) { return prg + prgMap[slot]; }
+    /// Return the size of the PRG-ROM in bytes
+    u32 prg_size() { return prgSize; }
+    /// Return the hash of the ROM
+    u64 rom_hash() { return romHash; }
+    /// Return the PRG RAM of the mapper
+    const u8* prg_ram() { return prgRam; }
+    /// Return the size of the PRG RAM in bytes
+    u32 prg_ram_size() { return prgRamSize; }
+    /// Return the size of the memory of this mapper in bytes (RAM and registers)
+    size_t footprint() {
+        size_t cached = (chrRam && chrCache != nullptr) ? chrCache->footprint() : 0;
+        return sizeof(Mapper) + prgRamSize + (chrRam ? chrSize : 0) + cached;
+    }
+    /// Return the size of the memory shared by the copies of this mapper in bytes
+    size_t shared_footprint() { return romSize + (chrRam ? 0 : chrCache->footprint()); }
     virtual u8 write(u16 addr, u8 v) { return v; }
 
     u8 chr_read(u16 addr);
+
+    /// Return 8 decoded pixels of the CHR row whose low plane is at addr
+    u64 chr_pixels(u16 addr, bool flip) {
+        return cache()->row(chr, chrMap[addr / 0x400] + (addr % 0x400), flip);
+    }
     virtual u8 chr_write(u16 addr, u8 v) { return v; }
 
     virtual void signal_scanline() {}
+
+    /// Write the mapper's registers and RAM to a state stream
+    virtual void serialize(StateWriter& stream);
+    /// Read the mapper's registers and RAM from a state stream
+    virtual void deserialize(StateReader& stream);
 };
@@ -21,7 +21,17 @@ public:
     }
 
     Mapper1* copy() { return new Mapper1(this); };
+    void assign(Mapper* mapper) {
+        Mapper::assign(mapper);
+        Mapper1* source = static_cast<Mapper1*>(mapper);
+        writeN = source->writeN;
+        tmpReg = source->tmpReg;
+        std::copy(std::begin(source->regs), std::end(source->regs), std::begin(regs));
+    };
 
     u8 write(u16 addr, u8 v);
     u8 chr_write(u16 addr, u8 v);
+
+    void serialize(StateWriter& stream);
+    void deserialize(StateReader& stream);
 };
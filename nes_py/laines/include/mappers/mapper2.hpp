@@ -19,7 +19,16 @@ public:
     }
 
     Mapper2* copy() { return new Mapper2(this); };
+    void assign(Mapper* mapper) {
+        Mapper::assign(mapper);
+        Mapper2* source = static_cast<Mapper2*>(mapper);
+        std::copy(std::begin(source->regs), std::end(source->regs), std::begin(regs));
+        vertical_mirroring = source->vertical_mirroring;
+    };
 
     u8 write(u16 addr, u8 v);
     u8 chr_write(u16 addr, u8 v);
+
+    void serialize(StateWriter& stream);
+    void deserialize(StateReader& stream);
 };
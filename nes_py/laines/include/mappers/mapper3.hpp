@@ -21,8 +21,18 @@ public:
     }
 
     Mapper3* copy() { return new Mapper3(this); };
+    void assign(Mapper* mapper) {
+        Mapper::assign(mapper);
+        Mapper3* source = static_cast<Mapper3*>(mapper);
+        std::copy(std::begin(source->regs), std::end(source->regs), std::begin(regs));
+        vertical_mirroring = source->vertical_mirroring;
+        PRG_size_16k = source->PRG_size_16k;
+    };
 
     u8 write(u16 addr, u8 v);
     u8 chr_write(u16 addr, u8 v);
+
+    void serialize(StateWriter& stream);
+    void deserialize(StateReader& stream);
 };
 
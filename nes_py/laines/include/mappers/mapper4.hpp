@@ -34,9 +34,22 @@ public:
     }
 
     Mapper4* copy() { return new Mapper4(this); };
+    void assign(Mapper* mapper) {
+        Mapper::assign(mapper);
+        Mapper4* source = static_cast<Mapper4*>(mapper);
+        reg8000 = source->reg8000;
+        std::copy(std::begin(source->regs), std::end(source->regs), std::begin(regs));
+        horizMirroring = source->horizMirroring;
+        irqPeriod = source->irqPeriod;
+        irqCounter = source->irqCounter;
+        irqEnabled = source->irqEnabled;
+    };
 
     u8 write(u16 addr, u8 v);
     u8 chr_write(u16 addr, u8 v);
 
+    void serialize(StateWriter& stream);
+    void deserialize(StateReader& stream);
+
     void signal_scanline();
 };
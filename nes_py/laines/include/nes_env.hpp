@@ -1,13 +1,180 @@
+#pragma once
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include "arena.hpp"
 #include "gamestate.hpp"
+#include "input_log.hpp"
+#include "latency.hpp"
+#include "profiler.hpp"
+#include "ram_predicate.hpp"
+#include "rollout.hpp"
+#include "state_archive.hpp"
+#include "state_file.hpp"
+#include "worker.hpp"
+
+/// The memory footprint of an environment in bytes (laid out for the Python API).
+struct MemoryFootprint {
+    /// the environment object (e.g., its latency histograms and counters)
+    u64 instance;
+    /// the game-state (CPU, PPU, joy-pad, and mapper RAM and registers)
+    u64 state;
+    /// the backup game-state and framebuffer (0 without a backup)
+    u64 backup;
+    /// the framebuffer (the video buffer and the screen)
+    u64 framebuffer;
+    /// the serialized state (in snapshots, clones, archives, and files)
+    u64 serialized;
+    /// the ROM and decoded CHR-ROM tiles (shared with clones)
+    u64 shared;
+};
+
+/// A golden post-boot state of a ROM that resets load instead of powering on
+struct ResetState {
+    /// the serialized machine state
+    std::vector<u8> state;
+    /// the framebuffer when the state was captured (black for files)
+    GUI gui;
+};
+
+/// The reward, done predicate, and info values of batched steps from RAM.
+struct BatchSpec {
+    /// the reward of a step (the change of the value over the step)
+    RewardSpec reward;
+    /// the predicate that ends an episode, tested after each frame
+    RamPredicate done;
+    /// the info values (the values at the end of a step)
+    std::vector<RewardSpec> info;
+
+    /**
+        Initialize a new batch specification.
+
+        @param reward_terms the terms of the reward (see RewardSpec)
+        @param reward_count the number of terms of the reward
+        @param done the conditions of the done predicate (see RamPredicate)
+        @param done_count the number of conditions
+        @param info_terms the terms of the info values, concatenated
+        @param info_sizes the number of terms of each info value
+        @param info_count the number of info values
+    */
+    BatchSpec(const RewardTerm* reward_terms, int reward_count,
+        const RamCondition* done, int done_count,
+        const RewardTerm* info_terms, const int* info_sizes, int info_count) :
+        reward(reward_terms, reward_count), done(done, done_count) {
+        for (int k = 0; k < info_count; info_terms += info_sizes[k++])
+            info.emplace_back(info_terms, info_sizes[k]);
+    }
+};
 
 /// An abstraction of an NES environment for OpenAI Gym
 class NESEnv {
+public:
+    /// the size of the RAM of the machine in bytes
+    static const u32 RAM_SIZE = 0x800;
+    /// the size of the PRG RAM window at $6000-$7FFF in bytes
+    static const u32 PRG_RAM_SIZE = 0x2000;
+
 private:
+    /// the environment whose game-state is loaded into the machine
+    static NESEnv* active;
+    /// the mutex serializing access to the machine across threads
+    static std::mutex machine;
+    /// the golden reset states of the ROMs (by the hash of the ROM)
+    static std::unordered_map<u64, std::shared_ptr<ResetState>> reset_states;
+    /// the identifier of the next environment (for traces)
+    static u32 next_id;
+    /// the identifier of this environment (for traces)
+    u32 id;
+    /**
+        the block holding the fixed-size parts of the game-states (CPU, PPU,
+        and joypad states) and the framebuffers of this environment and its
+        backup. the GameState objects, the cartridges and mappers (with
+        their PRG-RAM and CHR-RAM), and serialized snapshots live on the
+        heap (those of the backup are allocated once and reused)
+    */
+    Arena* arena;
     /// the current gamestate being emulated
     GameState* current_state;
     /// the backup gamestate to restore to
     GameState* backup_state;
+    /// the framebuffer the PPU draws this environment's frames in
+    GUI* gui;
+    /// the framebuffer when the backup was taken (nullptr until a backup)
+    GUI* backup_gui;
+    /// the background thread for asynchronous steps (created on demand)
+    Worker* worker;
+    /// the native reward, done, and info of asynchronous steps (or nullptr)
+    BatchSpec* step_spec;
+    /// whether the PPU outputs frames for this environment
+    bool render;
+    /// the format of the pixels the PPU outputs for this environment
+    PixelFormat pixel_format;
+    /// the input log being recorded (nullptr when not recording)
+    InputLog* recording;
+    /// whether the next recorded frame needs a keyframe
+    bool keyframe_pending;
+    /// the size of a serialized game-state in bytes (0 until measured)
+    size_t state_size;
+    /// the input log the machine is replaying (nullptr when not replaying)
+    InputLog* replay_log;
+    /// the frame in the replayed input log the machine is at
+    u32 replay_frame;
+    /// the hardware counters of this environment (see counters.hpp)
+    Counters hardware_counters;
+    /// the profiler of the guest code (nullptr when not profiling)
+    Profiler* profiler;
+    /// the watchpoints on the writes of this environment (nullptr until used)
+    Watchpoints* watchpoints;
+    /// the latencies of the operations of this environment
+    LatencyHistogram latencies[NUM_LATENCY_OPS];
+
+    /// Initialize the members of a new environment (with an empty cartridge).
+    void initialize();
+
+    /// Load this environment's game-state into the machine if it isn't.
+    void activate();
+
+    /// Save the active environment's game-state out of the machine.
+    static void deactivate();
+
+    /**
+        Run a frame on the machine and record its inputs if recording.
+
+        @param predicate a predicate to test after each instruction, or
+        nullptr to run the frame without testing
+        @returns the first clause of the predicate that held, or -1
+    */
+    int run_frame(const RamPredicate* predicate = nullptr);
+
+    /// Handle a change to the machine state that isn't from the inputs.
+    void state_changed();
+
+    /// Serialize the machine state of this (active) environment.
+    void save_state(StateWriter& stream);
+
+    /// Return the size of a serialized game-state of this environment.
+    size_t serialized_size();
+
+    /**
+        Deserialize the machine state of this (active) environment.
+
+        @param stream the stream to read the state from
+        @returns false (leaving the machine as it was) if the stream is too
+        short for a state
+    */
+    bool load_state(StateReader& stream);
+
+    /// Reset this (active) environment (see reset).
+    bool reset_machine();
+
+    /// Copy the RAM of this environment into buffers (see read_ram_batch).
+    void read_ram(u8* ram, u8* prg_ram);
+
+    /// Load the serialized machine state of another environment (of the same ROM).
+    bool load_clone(const std::vector<u8>& state);
+
+    /// Load a keyframe of an input log into this (active) environment.
+    bool load_keyframe(const Keyframe* keyframe);
 
 public:
 
@@ -19,8 +186,49 @@ public:
     */
     NESEnv(wchar_t* path);
 
-    /// Reset the emulator to its initial state.
-    void reset();
+    /**
+        Initialize a new NESEnv as a clone of another. The clone shares the
+        ROM of the source and copies only its mutable state.
+
+        @param source the environment to clone
+        @returns a new instance of NESEnv in the state of the source
+    */
+    NESEnv(NESEnv* source);
+
+    /// Delete an instance of NESEnv.
+    ~NESEnv();
+
+    /**
+        Reset the emulator to its initial state. If the ROM has a golden
+        reset state, the state (and its video buffers) is loaded in place
+        of powering on the machine.
+
+        @returns false if the golden reset state failed to load. the state
+        is removed and the machine is powered on instead
+    */
+    bool reset();
+
+    /**
+        Set the current machine state as the golden reset state of the ROM
+        for all the environments of the ROM in the process.
+    */
+    void set_reset_state();
+
+    /**
+        Set the state of a save-state file as the golden reset state of the
+        ROM. The screen of the state is black until the first frame.
+
+        @param file the save-state file to load the state from
+        @returns false if the file is for another ROM or its state doesn't
+        load (the golden reset state is unchanged)
+    */
+    bool set_reset_state_file(StateFile* file);
+
+    /// Remove the golden reset state of the ROM (resets power on again).
+    void clear_reset_state();
+
+    /// Return true if the ROM has a golden reset state.
+    bool has_reset_state();
 
     /**
         Perform a discrete "step" of the NES by rendering 1 frame.
@@ -39,9 +247,361 @@ public:
     */
     void step(unsigned char action);
 
+    /**
+        Step the NES with an action until a predicate on the RAM holds.
+
+        @param action the controller bitmap of which buttons to press
+        @param conditions the conditions of the predicate (see RamPredicate)
+        @param count the number of conditions
+        @param max_frames the largest number of frames to run
+        @param per_instruction whether to test after each instruction
+        instead of after each frame. the frame the predicate holds in
+        still runs to the end
+        @param clause the clause that held, or -1 if none did in time
+        @returns the number of frames run. 0 if the predicate already held
+    */
+    u32 run_until(
+        unsigned char action,
+        const RamCondition* conditions,
+        int count,
+        u32 max_frames,
+        bool per_instruction,
+        int* clause
+    );
+
+    /**
+        Step a batch of environments and reset the episodes that end in
+        place (from the golden reset state of the ROM if it has one).
+
+        @param envs the environments to step
+        @param count the number of environments
+        @param actions the action of each environment
+        @param frames the number of frames of a step
+        @param spec the reward, done predicate, and info values of the steps
+        @param rewards the buffer for the reward of each environment
+        @param dones the buffer for whether the episode of each environment
+        ended (and was reset)
+        @param infos the (count, info values) buffer for the info values at
+        the end of each step (before a reset)
+        @param screens the buffer for the screen of each environment after
+        the step (the first screen of the next episode if it ended)
+        @param terminal_screens the buffer for the last screen of the
+        episodes that ended (the screens of other environments are unchanged)
+        @param ram the (count, RAM_SIZE) buffer for the RAM of each
+        environment after the step (after a reset), or nullptr to skip it
+    */
+    static void step_batch(
+        NESEnv** envs,
+        int count,
+        const u8* actions,
+        int frames,
+        BatchSpec& spec,
+        double* rewards,
+        u8* dones,
+        double* infos,
+        u8* screens,
+        u8* terminal_screens,
+        u8* ram = nullptr
+    );
+
+    /**
+        Copy the RAM of a batch of environments into rows of one buffer.
+
+        @param envs the environments to read
+        @param count the number of environments
+        @param ram the (count, RAM_SIZE) buffer for the RAM
+        @param prg_ram the (count, PRG_RAM_SIZE) buffer for the PRG RAM at
+        $6000-$7FFF (zeros past the PRG RAM of a cartridge), or nullptr to
+        skip it
+    */
+    static void read_ram_batch(NESEnv** envs, int count, u8* ram, u8* prg_ram);
+
+    /**
+        Run open-loop rollouts of action sequences from the current state in
+        parallel worker processes with rendering disabled. The environment
+        is left in its current state.
+
+        @param actions the (rollouts, length) matrix of actions
+        @param rollouts the number of action sequences
+        @param length the number of frames of each action sequence
+        @param terms the terms of the reward (see RewardSpec)
+        @param term_count the number of terms
+        @param done the conditions of a predicate that ends a rollout early
+        (see RamPredicate), tested after each frame
+        @param done_count the number of conditions
+        @param workers the number of worker processes forked for this call
+        (1 runs the rollouts in this process, see run_forked)
+        @param rewards the output buffer for the reward of each rollout (NaN
+        if the rollout failed to load the current state)
+        @param frames the output buffer for the frames run by each rollout
+        @param final_ram the output buffer for the (rollouts, 2048) RAM after
+        each rollout
+    */
+    void rollout(
+        const u8* actions,
+        int rollouts,
+        int length,
+        const RewardTerm* terms,
+        int term_count,
+        const RamCondition* done,
+        int done_count,
+        int workers,
+        double* rewards,
+        u32* frames,
+        u8* final_ram
+    );
+
+    /**
+        Set the native reward, done predicate, and info values of the
+        asynchronous steps of this environment (see step_async).
+
+        @param spec the specification of the step (owned by the environment
+        from now on), or nullptr to run steps without one
+    */
+    void set_step_spec(BatchSpec* spec);
+
+    /**
+        Start stepping the NES on a background thread and return immediately.
+        With a step specification (see set_step_spec), the done predicate
+        is tested after each frame and ends the step early when it holds,
+        like the batched steps (see step_batch).
+
+        @param action the controller bitmap of which buttons to press
+        @param frames the number of frames to run with the action
+        @param output_buffer the buffer to copy the screen to after the
+        last frame. it must stay valid until step_wait returns
+        @param reward the output for the change of the reward over the step
+        @param done the output for whether the done predicate held
+        @param infos the output for the info values at the end of the step
+        (the outputs are unchanged without a step specification)
+    */
+    void step_async(unsigned char action, int frames, unsigned char *output_buffer,
+        double* reward, u8* done, double* infos);
+
+    /// Block until the last asynchronous step finishes.
+    void step_wait();
+
+    /**
+        Enable or disable rendering frames to the screen. Emulation is
+        unaffected, but the screen isn't updated while disabled.
+
+        @param enabled whether to render frames
+    */
+    void set_render(bool enabled);
+
+    /**
+        Set the format of the pixels in rendered frames.
+
+        @param format the format of the pixels (see PixelFormat)
+    */
+    void set_pixel_format(PixelFormat format);
+
+    /**
+        Read a symbolic observation of the screen. It doesn't need rendering,
+        so it can be used with rendering disabled.
+
+        @param observation the observation to fill
+    */
+    void observe(SymbolicObservation* observation);
+
+    /**
+        Start recording the joy-pad inputs of each frame to an input log.
+
+        @param keyframe_interval the number of frames between keyframes
+    */
+    void record(u32 keyframe_interval);
+
+    /**
+        Stop recording and write the input log to a file.
+
+        @param path the path of the file to write, or nullptr to discard
+        @returns true if the log was written
+    */
+    bool stop_recording(const char* path);
+
+    /**
+        Seek the machine to the state after a frame of an input log by
+        loading the nearest keyframe and re-simulating the frames after it
+        with rendering disabled. Only the last simulated frame is rendered.
+
+        @param log the input log to replay
+        @param frame the number of frames of the log to replay
+        @returns true if the frame is in the log and a keyframe precedes it.
+        false if the log is for another ROM (the machine is unchanged)
+    */
+    bool seek(InputLog* log, u32 frame);
+
+    /**
+        Write a snapshot of the machine state to a state stream. The
+        snapshot excludes the screen.
+
+        @param stream the stream to write the snapshot to
+    */
+    void save_snapshot(StateWriter& stream);
+
+    /**
+        Load a snapshot of the machine state from a state stream.
+
+        @param stream the stream to read the snapshot from
+        @returns true if the stream held a complete snapshot
+    */
+    bool load_snapshot(StateReader& stream);
+
+    /**
+        Copy the hardware counters of this environment. The counters are
+        zero unless compiled with NES_COUNTERS defined.
+
+        @param output the counters to copy into
+    */
+    void get_counters(Counters* output);
+
+    /**
+        Measure the memory footprint of this environment.
+
+        @param output the footprint to fill in
+    */
+    void footprint(MemoryFootprint* output);
+
+    /// Reset the hardware counters of this environment to zero.
+    void reset_counters();
+
+    /**
+        Start profiling the opcodes and program counters of the guest code.
+
+        @param interval the number of instructions between samples. 1
+        counts every instruction exactly
+    */
+    void profile(u32 interval);
+
+    /**
+        Stop profiling and write the profile to a file.
+
+        @param path the path of the file to write, or nullptr to discard
+        @returns true if the profile was written
+    */
+    bool stop_profile(const char* path);
+
+    /**
+        Copy the machine state of this environment into existing ones. The
+        state is serialized once and only the mutable state (RAM, CIRAM,
+        OAM, PRG/CHR-RAM, and registers) is copied, along with the
+        framebuffer the frame in progress is drawn over.
+
+        @param targets the environments to copy the state into
+        @param count the number of environments
+        @returns true if the state was copied. false if a target is for
+        another ROM (no target is changed) or the state failed to load
+    */
+    bool broadcast(NESEnv** targets, int count);
+
+    /// Return the hash of the ROM of this environment.
+    u64 rom_hash();
+
+    /**
+        Write the machine state to a save-state file.
+
+        @param path the path of the file to write
+        @returns true if the file was written
+    */
+    bool save_state_file(const char* path);
+
+    /**
+        Load the machine state from an open save-state file.
+
+        @param file the save-state file to load
+        @returns true if the state was loaded. false if the file is for
+        another ROM (the machine is unchanged) or its state is truncated
+    */
+    bool load_state_file(StateFile* file);
+
+    /**
+        Append the machine state to an archive.
+
+        @param archive the archive to append to
+        @param key the key of the record. set to the hash of the state if
+        hash_key is true
+        @param hash_key whether to key the record by the hash of the state
+        @param metadata the metadata of the record
+        @param metadata_size the size of the metadata in bytes
+        @param replace whether to replace an existing record with the key
+        @returns true if the record was appended. false if the archive is
+        for another ROM, the key exists and replace is false, or the write
+        failed
+    */
+    bool archive_state(StateArchive* archive, u64* key, bool hash_key,
+        const u8* metadata, u32 metadata_size, bool replace);
+
+    /**
+        Load the machine state of a key from an archive.
+
+        @param archive the archive to load from
+        @param key the key of the record to load
+        @returns true if the state was loaded. false if the archive is for
+        another ROM or doesn't have the key (the machine is unchanged), or
+        the state is truncated
+    */
+    bool restore_archived(StateArchive* archive, u64 key);
+
+    /**
+        Summarize the latencies of an operation of this environment.
+
+        @param op the operation (see LatencyOp)
+        @param percents the percentiles to compute (e.g., 50, 99, 99.9)
+        @param count the number of percentiles
+        @param output the buffer for the count of the operations, the mean,
+        the maximum, and then each percentile (in nanoseconds)
+    */
+    void latency(LatencyOp op, const double* percents, int count, double* output);
+
+    /// Remove the recorded latencies of this environment.
+    void reset_latency();
+
+    /**
+        Watch or stop watching CPU writes to an address.
+
+        @param address the address to watch in RAM ($0000-$1FFF, watching
+        all its mirrors) or PRG-RAM ($6000-$7FFF)
+        @param enabled whether to watch the address
+        @returns false if the address can't be watched
+    */
+    bool watch(u16 address, bool enabled);
+
+    /**
+        Copy the writes to watched addresses since the last drain and clear
+        them.
+
+        @param output the buffer of at least Watchpoints::MAX_EVENTS events
+        @param dropped the number of writes dropped because the buffer was full
+        @returns the number of events copied
+    */
+    u32 watch_events(WatchEvent* output, u32* dropped);
+
     /// Backup the game state to the backup.
     void backup();
 
     /// Restore the gamestate from the backup.
     void restore();
+
+    /**
+        Return the value of the given memory address.
+
+        @param address the 16-bit address to read from memory
+        @returns the byte located at the given address
+    */
+    u8 read_mem(u16 address);
+
+    /**
+        Write a value to the given memory address.
+
+        @param address the 16-bit address to write to memory
+        @param value the 8-bit value to write to the given memory address
+    */
+    void write_mem(u16 address, u8 value);
+
+    /**
+        Copy the screen into an output buffer of unsigned bytes.
+
+        @param output_buffer the pointer to the output buffer
+    */
+    void screen(unsigned char *output_buffer);
 };
@@ -1,8 +1,10 @@
 #pragma once
 #include <iostream>
 #include "common.hpp"
+#include "counters.hpp"
 #include "gui.hpp"
 #include "cartridge.hpp"
+#include "state_stream.hpp"
 
 /// Scanline configuration options
 enum Scanline  { VISIBLE, POST, NMI, PRE };
@@ -25,6 +27,19 @@ struct Sprite {
     u8 dataL;
     /// Tile data (high)
     u8 dataH;
+
+    /// Write the sprite to a state stream
+    void serialize(StateWriter& stream) {
+        stream.write(id); stream.write(x); stream.write(y); stream.write(tile);
+        stream.write(attr); stream.write(dataL); stream.write(dataH);
+    }
+
+    /// Read the sprite from a state stream
+    void deserialize(StateReader& stream) {
+        id = stream.read<u8>(); x = stream.read<u8>(); y = stream.read<u8>();
+        tile = stream.read<u8>(); attr = stream.read<u8>();
+        dataL = stream.read<u8>(); dataH = stream.read<u8>();
+    }
 };
 
 /// PPUCTRL ($2000) register
@@ -118,8 +133,6 @@ struct PPUState {
     u8 oamMem[0x100];
     /// Sprite buffers
     Sprite oam[8], secOam[8];
-    /// Video buffer
-    u32 pixels[256 * 240];
     /// Loopy V, T
     Addr vAddr, tAddr;
     /// Fine X
@@ -140,15 +153,30 @@ struct PPUState {
     /// Rendering counters:
     int scanline, dot;
     bool frameOdd;
+    /// Register access result, VRAM read buffer, and second write latch
+    u8 res, buffer; bool latch;
+    /// Address of the current background fetch
+    u16 fetchAddr;
 
     /// Initialize a new PPU State
     PPUState() {
+        mirroring = HORIZONTAL;
         frameOdd = false;
         scanline = dot = 0;
         ctrl.r = mask.r = status.r = 0;
-        memset(pixels, 0x00, sizeof(pixels));
         memset(ciRam,  0xFF, sizeof(ciRam));
+        memset(cgRam,  0x00, sizeof(cgRam));
         memset(oamMem, 0x00, sizeof(oamMem));
+        memset(oam,    0x00, sizeof(oam));
+        memset(secOam, 0x00, sizeof(secOam));
+        vAddr.r = tAddr.r = 0;
+        fX = oamAddr = 0;
+        nt = at = bgL = bgH = 0;
+        atShiftL = atShiftH = 0; bgShiftL = bgShiftH = 0;
+        atLatchL = atLatchH = false;
+        res = buffer = 0;
+        latch = false;
+        fetchAddr = 0;
     }
 
     /// Initialize a new PPU State as a copy of another
@@ -159,7 +187,6 @@ struct PPUState {
         std::copy(std::begin(state->oamMem), std::end(state->oamMem), std::begin(oamMem));
         std::copy(std::begin(state->oam), std::end(state->oam), std::begin(oam));
         std::copy(std::begin(state->secOam), std::end(state->secOam), std::begin(secOam));
-        std::copy(std::begin(state->pixels), std::end(state->pixels), std::begin(pixels));
         vAddr = state->vAddr;
         tAddr = state->tAddr;
         fX = state->fX;
@@ -180,9 +207,88 @@ struct PPUState {
         scanline = state->scanline;
         dot = state->dot;
         frameOdd = state->frameOdd;
+        res = state->res;
+        buffer = state->buffer;
+        latch = state->latch;
+        fetchAddr = state->fetchAddr;
+    }
+
+    /// Write the PPU state (without the video buffer) to a state stream
+    void serialize(StateWriter& stream) {
+        stream.write<u8>(mirroring);
+        stream.write(ciRam, sizeof(ciRam));
+        stream.write(cgRam, sizeof(cgRam));
+        stream.write(oamMem, sizeof(oamMem));
+        for (int i = 0; i < 8; i++) oam[i].serialize(stream);
+        for (int i = 0; i < 8; i++) secOam[i].serialize(stream);
+        stream.write<u16>(vAddr.r); stream.write<u16>(tAddr.r);
+        stream.write(fX); stream.write(oamAddr);
+        stream.write(ctrl.r); stream.write(mask.r); stream.write(status.r);
+        stream.write(nt); stream.write(at); stream.write(bgL); stream.write(bgH);
+        stream.write(atShiftL); stream.write(atShiftH);
+        stream.write(bgShiftL); stream.write(bgShiftH);
+        stream.write(atLatchL); stream.write(atLatchH);
+        stream.write(scanline); stream.write(dot); stream.write(frameOdd);
+        stream.write(res); stream.write(buffer); stream.write(latch);
+        stream.write(fetchAddr);
+    }
+
+    /// Read the PPU state (without the video buffer) from a state stream
+    void deserialize(StateReader& stream) {
+        mirroring = static_cast<Mirroring>(stream.read<u8>());
+        stream.read(ciRam, sizeof(ciRam));
+        stream.read(cgRam, sizeof(cgRam));
+        stream.read(oamMem, sizeof(oamMem));
+        for (int i = 0; i < 8; i++) oam[i].deserialize(stream);
+        for (int i = 0; i < 8; i++) secOam[i].deserialize(stream);
+        vAddr.r = stream.read<u16>(); tAddr.r = stream.read<u16>();
+        fX = stream.read<u8>(); oamAddr = stream.read<u8>();
+        ctrl.r = stream.read<u8>(); mask.r = stream.read<u8>();
+        status.r = stream.read<u8>();
+        nt = stream.read<u8>(); at = stream.read<u8>();
+        bgL = stream.read<u8>(); bgH = stream.read<u8>();
+        atShiftL = stream.read<u8>(); atShiftH = stream.read<u8>();
+        bgShiftL = stream.read<u16>(); bgShiftH = stream.read<u16>();
+        atLatchL = stream.read<bool>(); atLatchH = stream.read<bool>();
+        scanline = stream.read<int>(); dot = stream.read<int>();
+        frameOdd = stream.read<bool>();
+        res = stream.read<u8>(); buffer = stream.read<u8>();
+        latch = stream.read<bool>();
+        fetchAddr = stream.read<u16>();
     }
 };
 
+/**
+    A symbolic observation of the screen: the background tiles of the
+    visible nametable region and the sprites in OAM. The region starts at
+    the coarse scroll of the last scroll write (in split-screen games, the
+    scroll of the last split).
+*/
+struct SymbolicObservation {
+    /// the pattern index of each visible background tile
+    u8 tiles[30][32];
+    /// the attribute palette (0-3) of each visible background tile
+    u8 palettes[30][32];
+    /// the 64 sprites in OAM as Y, pattern index, attributes, and X
+    u8 sprites[64][4];
+    /// the fine scroll in pixels (0-7) in X and Y
+    u8 fineX, fineY;
+    /// the pattern table (0 or 1) of the background and of 8x8 sprites
+    u8 bgTable, sprTable;
+    /// the height of the sprites in pixels (8 or 16)
+    u8 sprHeight;
+};
+
+/// The formats the PPU can output pixels in
+enum PixelFormat {
+    /// 24-bit RGB colors
+    PIXEL_RGB,
+    /// the luminance of the RGB colors in each channel
+    PIXEL_GRAY,
+    /// the NES color index (0-63) in each channel
+    PIXEL_INDEX
+};
+
 /// The Picture Processing Unit
 namespace PPU {
 
@@ -200,6 +306,30 @@ namespace PPU {
 
     template <bool write> u8 access(u16 index, u8 v = 0);
     void set_mirroring(Mirroring mode);
+    Mirroring get_mirroring();
+
+    /**
+        Enable or disable the output of pixels to the video buffer and GUI.
+        Sprite 0 hits are still evaluated while the output is disabled.
+
+        @param enabled whether to output pixels
+    */
+    void set_output(bool enabled);
+
+    /**
+        Set the format of the pixels output to the video buffer. Pixels
+        that were already output keep their format.
+
+        @param format the format to output pixels in
+    */
+    void set_pixel_format(PixelFormat format);
+
+    /**
+        Read a symbolic observation of the screen from the PPU memory.
+
+        @param observation the observation to fill
+    */
+    void observe(SymbolicObservation* observation);
 
     /// Execute a PPU cycle.
     void step();
@@ -210,6 +340,9 @@ namespace PPU {
     /// Return a new PPU state of the PPU variables
     PPUState* get_state();
 
+    /// Copy the PPU variables into an existing PPU state
+    void get_state(PPUState* state);
+
     /// Restore the PPU variables from a saved state
     void set_state(PPUState* state);
 }
@@ -0,0 +1,72 @@
+#pragma once
+#include <vector>
+#include "common.hpp"
+
+/**
+    A profiler of the guest code that counts executed opcodes and the
+    program counter of each instruction. PCs in $8000-$FFFF are counted by
+    their offset in PRG-ROM so that bank-switched code maps back to the ROM.
+*/
+class Profiler {
+private:
+    /// the number of instructions between samples (1 to count all of them)
+    u32 interval;
+    /// the number of instructions until the next sample
+    u32 countdown;
+    /// the number of instructions sampled
+    u64 samples;
+    /// the number of samples of each opcode
+    u64 opcodes[256];
+    /// the number of samples at each offset in PRG-ROM
+    std::vector<u64> prg_hits;
+    /// the CPU address each PRG-ROM offset was last executed at
+    std::vector<u16> prg_addresses;
+    /// the number of samples at each address below $8000 (RAM / PRG-RAM)
+    std::vector<u64> low_hits;
+
+public:
+    /**
+        Initialize a new profiler.
+
+        @param prg_size the size of the PRG-ROM of the cartridge in bytes
+        @param interval the number of instructions between samples. 1
+        counts every instruction exactly
+    */
+    Profiler(u32 prg_size, u32 interval);
+
+    /// Return true if the next instruction should be sampled.
+    inline bool sample() {
+        if (--countdown)
+            return false;
+        countdown = interval;
+        return true;
+    }
+
+    /**
+        Record a sampled instruction.
+
+        @param opcode the opcode of the instruction
+        @param pc the address of the instruction
+        @param prg_offset the offset of the address in PRG-ROM if the
+        address is in $8000-$FFFF
+    */
+    inline void record(u8 opcode, u16 pc, u32 prg_offset) {
+        samples++;
+        opcodes[opcode]++;
+        if (pc >= 0x8000) {
+            prg_hits[prg_offset]++;
+            prg_addresses[prg_offset] = pc;
+        } else
+            low_hits[pc]++;
+    }
+
+    /**
+        Write the opcode histogram and the PC heat map to a text file,
+        sorted by the number of samples. PRG-ROM addresses are listed by
+        8KB bank, CPU address, and offset in the iNES file.
+
+        @param path the path of the file to write
+        @returns true if the file was written
+    */
+    bool dump(const char* path);
+};
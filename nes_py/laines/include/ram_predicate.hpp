@@ -0,0 +1,87 @@
+#pragma once
+#include <vector>
+#include "common.hpp"
+
+/// The comparisons of a condition on a byte of RAM
+enum RamOp { RAM_EQ, RAM_NE, RAM_LT, RAM_LE, RAM_GT, RAM_GE, RAM_CHANGED };
+
+/// A condition on a byte of RAM (laid out for the Python API).
+struct RamCondition {
+    /// the address of the byte in RAM (mirrored into $0000-$07FF)
+    u16 address;
+    /// the comparison (see RamOp)
+    u8 op;
+    /// the value to compare the masked byte to (unused by RAM_CHANGED)
+    u8 value;
+    /// the bits of the byte to compare
+    u8 mask;
+    /// the clause of the condition
+    u16 clause;
+};
+
+/**
+    A compound predicate on RAM: the conditions of a clause must all hold,
+    and the predicate holds when any of its clauses does. RAM_CHANGED
+    conditions compare with the RAM when the predicate started.
+*/
+class RamPredicate {
+private:
+    /// the conditions ordered by clause
+    std::vector<RamCondition> conditions;
+    /// the masked value of each condition's byte when the predicate started
+    std::vector<u8> baseline;
+
+    /// Return true if a condition holds for the masked value of its byte.
+    inline bool holds(int index, u8 byte) const {
+        const RamCondition& condition = conditions[index];
+        switch (condition.op) {
+            case RAM_EQ:      return byte == condition.value;
+            case RAM_NE:      return byte != condition.value;
+            case RAM_LT:      return byte <  condition.value;
+            case RAM_LE:      return byte <= condition.value;
+            case RAM_GT:      return byte >  condition.value;
+            case RAM_GE:      return byte >= condition.value;
+            case RAM_CHANGED: return byte != baseline[index];
+            default:          return false;
+        }
+    }
+
+public:
+    /**
+        Initialize a new predicate.
+
+        @param conditions the conditions of the predicate
+        @param count the number of conditions. without conditions the
+        predicate never holds
+    */
+    RamPredicate(const RamCondition* conditions, int count);
+
+    /**
+        Record the RAM the RAM_CHANGED conditions compare with.
+
+        @param read a function returning the byte of RAM at an address
+    */
+    template <typename Read> void start(Read read) {
+        for (size_t i = 0; i < conditions.size(); i++)
+            baseline[i] = read(conditions[i].address) & conditions[i].mask;
+    }
+
+    /**
+        Test the predicate on the RAM.
+
+        @param read a function returning the byte of RAM at an address
+        @returns the first clause (by number) that holds, or -1 if none do
+    */
+    template <typename Read> int test(Read read) const {
+        size_t i = 0;
+        while (i < conditions.size()) {
+            u16 clause = conditions[i].clause;
+            bool all = true;
+            for (; i < conditions.size() && conditions[i].clause == clause; i++)
+                all = all && holds(i, read(conditions[i].address) & conditions[i].mask);
+            if (all)
+                return clause;
+        }
+        return -1;
+    }
+};
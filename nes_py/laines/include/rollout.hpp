@@ -0,0 +1,105 @@
+#pragma once
+#include <algorithm>
+#include <functional>
+#include <vector>
+#include "common.hpp"
+
+/// The encodings of the values of reward terms in RAM
+enum RewardFormat {
+    /// an unsigned integer with the least significant byte first
+    REWARD_LITTLE_ENDIAN,
+    /// an unsigned integer with the most significant byte first
+    REWARD_BIG_ENDIAN,
+    /// a decimal number with one digit per byte, most significant first
+    REWARD_DIGITS
+};
+
+/// A term of a reward computed from RAM (laid out for the Python API).
+struct RewardTerm {
+    /// the address of the first byte of the value
+    u16 address;
+    /// the number of bytes of the value (1-8)
+    u8 length;
+    /// the encoding of the value (see RewardFormat)
+    u8 format;
+    /// the weight of the change of the value
+    float weight;
+};
+
+/**
+    A reward computed from RAM: the weighted sum of the changes of values
+    in RAM (e.g., the score, the X position) between frames.
+*/
+class RewardSpec {
+private:
+    /// the terms of the reward
+    std::vector<RewardTerm> terms;
+
+public:
+    /**
+        Initialize a new reward.
+
+        @param terms the terms of the reward
+        @param count the number of terms. the lengths of the terms are
+        clamped to 1-8 bytes (the width of the sum of a term)
+    */
+    RewardSpec(const RewardTerm* terms, int count) : terms(terms, terms + count) {
+        for (RewardTerm& term : this->terms)
+            term.length = std::min<u8>(std::max<u8>(term.length, 1), 8);
+    }
+
+    /**
+        Return the weighted sum of the values in RAM.
+
+        @param read a function returning the byte of RAM at an address
+        @returns the weighted sum. the reward of a frame is the change of
+        the sum over the frame
+    */
+    template <typename Read> double value(Read read) const {
+        double sum = 0;
+        for (const RewardTerm& term : terms) {
+            u64 value = 0;
+            for (int i = 0; i < term.length; i++) {
+                u8 byte = read(term.address + i);
+                switch (term.format) {
+                    case REWARD_LITTLE_ENDIAN: value |= static_cast<u64>(byte) << (8 * i); break;
+                    case REWARD_BIG_ENDIAN:    value = (value << 8) | byte; break;
+                    case REWARD_DIGITS:        value = value * 10 + byte % 10; break;
+                }
+            }
+            sum += term.weight * static_cast<double>(value);
+        }
+        return sum;
+    }
+};
+
+/// The results of a rollout.
+struct RolloutResult {
+    /// the sum of the rewards of the frames
+    double reward;
+    /// the number of frames run
+    u32 frames;
+    /// the RAM after the last frame
+    u8 ram[0x800];
+};
+
+/**
+    Run jobs in worker processes forked from this one. Each job fills a
+    result in memory shared with the workers. Jobs of workers that can't
+    be forked run in this process.
+
+    The workers are forked per call rather than pooled: the fork hands them
+    the machine state copy-on-write, which a pool would have to serialize
+    to each worker every call. A fork costs about a millisecond, so it pays
+    off when each worker's share of the jobs runs for longer than that.
+
+    @param jobs the number of jobs
+    @param workers the number of worker processes
+    @param job the function to run a job. it must not lock mutexes or
+    allocate memory other threads might hold at the fork
+    @param results the buffer to copy the results of the jobs to
+    @returns false if the jobs couldn't run in worker processes or a worker
+    failed (the results are unchanged, so the caller can run the jobs itself)
+*/
+bool run_forked(int jobs, int workers,
+    const std::function<void(int, RolloutResult*)>& job, RolloutResult* results);
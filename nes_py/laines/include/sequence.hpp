@@ -0,0 +1,41 @@
+#pragma once
+#include "common.hpp"
+
+/**
+    Counters in shared memory for a lock-free command/completion protocol.
+    A producer publishes work by storing an incremented counter and a
+    consumer waits for the counter to reach the value it expects next.
+
+    A counter is two 32-bit words (initialized to zero): its value, followed
+    by the number of processes blocked on it. Stores only make a system call
+    to wake the waiters when there are any.
+*/
+namespace Sequence {
+
+    /**
+        Return the current value of a counter.
+
+        @param seq the pointer to the counter in shared memory
+        @returns the value of the counter (acquire semantics)
+    */
+    u32 load(u32* seq);
+
+    /**
+        Publish a new value for a counter and wake any waiting process.
+
+        @param seq the pointer to the counter in shared memory
+        @param value the new value of the counter (release semantics)
+    */
+    void store(u32* seq, u32 value);
+
+    /**
+        Block until a counter reaches a given value or a timeout expires.
+
+        @param seq the pointer to the counter in shared memory
+        @param value the value to wait for (wrap-around safe)
+        @param timeout the number of milliseconds to wait for, or a negative
+        number to wait indefinitely
+        @returns true if the counter reached the value, false on timeout
+    */
+    bool wait(u32* seq, u32 value, int timeout = -1);
+}
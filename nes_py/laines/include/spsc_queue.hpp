@@ -0,0 +1,110 @@
+#pragma once
+#include <cstddef>
+#include "common.hpp"
+
+/**
+    The header of a queue in shared memory. The counters written by the
+    producer and by the consumer are on separate cache lines, and the slots
+    start on the cache line after the header.
+*/
+struct QueueHeader {
+    /// the number of items pushed (written by the producer)
+    u32 head;
+    /// the number of processes waiting on the head (see sequence.hpp)
+    u32 head_waiters;
+    u32 head_padding[14];
+    /// the number of items popped (written by the consumer)
+    u32 tail;
+    /// the number of processes waiting on the tail (see sequence.hpp)
+    u32 tail_waiters;
+    u32 tail_padding[14];
+    /// the number of slots
+    u32 capacity;
+    /// the size of a slot in bytes (a multiple of the cache line)
+    u32 slot_size;
+    u32 slot_padding[14];
+};
+
+/**
+    A lock-free queue of fixed-size slots in (shared) memory for one
+    producer and one consumer, e.g., in different processes. Items are
+    written and read in place, so pushing and popping never allocate or
+    copy. A full or empty queue blocks on its counters (see sequence.hpp).
+*/
+class SpscQueue {
+private:
+    /// the header of the queue
+    QueueHeader* header;
+    /// the first slot of the queue
+    u8* slots;
+
+public:
+    /// the size of a cache line in bytes
+    static const u32 LINE = 64;
+    /// the slot index returned by back and front when their wait times out
+    static const u32 TIMEOUT = 0xFFFFFFFF;
+
+    /**
+        Return the size of the memory for a queue.
+
+        @param capacity the number of slots
+        @param slot_size the size of a slot in bytes
+        @returns the number of bytes to allocate for the queue
+    */
+    static size_t size(u32 capacity, u32 slot_size);
+
+    /**
+        Initialize an empty queue in memory.
+
+        @param memory the memory for the queue (see size), aligned to a
+        cache line
+        @param capacity the number of slots (a power of two, so the slots
+        stay in order when the counters wrap around)
+        @param slot_size the size of a slot in bytes
+    */
+    static void initialize(void* memory, u32 capacity, u32 slot_size);
+
+    /**
+        Attach to a queue initialized in memory.
+
+        @param memory the memory of the queue
+    */
+    explicit SpscQueue(void* memory) :
+        header(static_cast<QueueHeader*>(memory)),
+        slots(static_cast<u8*>(memory) + sizeof(QueueHeader)) { }
+
+    /// Return the slot at an index.
+    u8* slot(u32 index) { return slots + static_cast<size_t>(index) * header->slot_size; }
+
+    /// Return the index of the slot of an item number.
+    u32 index(u32 item) { return item % header->capacity; }
+
+    /// Return the number of items in the queue.
+    u32 count();
+
+    /**
+        Return the index of the slot for the producer to write the next item
+        in, blocking while the queue is full.
+
+        @param timeout the number of milliseconds to block for, or a
+        negative number to block indefinitely
+        @returns the index of the slot, or TIMEOUT if the queue stayed full
+    */
+    u32 back(int timeout = -1);
+
+    /// Publish the item written in the slot from back (producer only).
+    void push();
+
+    /**
+        Return the index of the slot of the oldest item, blocking while the
+        queue is empty.
+
+        @param timeout the number of milliseconds to block for, or a
+        negative number to block indefinitely
+        @returns the index of the slot, or TIMEOUT if the queue stayed empty
+    */
+    u32 front(int timeout = -1);
+
+    /// Free the slot of the item from front (consumer only).
+    void pop();
+};
@@ -0,0 +1,112 @@
+#pragma once
+#include <cstdio>
+#include <unordered_map>
+#include <vector>
+#include "common.hpp"
+
+/**
+    An append-only archive of machine states keyed by 64-bit hashes (e.g.,
+    the cells of an exploration algorithm). Each record holds a key, a
+    metadata blob, and a serialized machine state (see StateWriter). Adding
+    a key again appends a new record that replaces the old one in the index.
+
+    The file is memory-mapped read-only, so only the records that are read
+    are paged in. An index of the keys to their latest records is built by
+    scanning the record headers when the archive is opened. A truncated
+    record at the end (e.g., from a crash) is discarded.
+
+    The archive isn't thread-safe.
+*/
+class StateArchive {
+private:
+    /// the file to append records to
+    FILE* file;
+    /// the hash of the ROM of the states in the archive
+    u64 romHash;
+    /// the offset of the end of the last record
+    u64 end;
+    /// the offset of the latest record of each key
+    std::unordered_map<u64, u64> index;
+    /// the keys in the order they were first added
+    std::vector<u64> keys;
+    /// the mapped bytes of the file (nullptr if not mapped)
+    const u8* mapped;
+    /// the number of mapped bytes
+    u64 mappedSize;
+    /// the bytes of the last record read when the file can't be mapped
+    std::vector<u8> scratch;
+
+    /// Initialize a new archive for an open file.
+    StateArchive(FILE* file, u64 rom_hash);
+
+    /// Return the bytes of the file at an offset (valid until the next read).
+    const u8* view(u64 offset, u64 size);
+
+    /// Index the records of the file, returning false if the file is invalid.
+    bool scan();
+
+public:
+    /// the size of the header of the archive in bytes
+    static const u64 HEADER_SIZE = 16;
+    /// the size of the header of a record in bytes
+    static const u64 RECORD_HEADER_SIZE = 16;
+
+    /**
+        Open an archive, creating it if it doesn't exist.
+
+        @param path the path of the archive file
+        @param rom_hash the hash of the ROM of the states
+        @returns the archive, or nullptr if the file isn't an archive of the ROM
+    */
+    static StateArchive* open(const char* path, u64 rom_hash);
+
+    /// Close the archive.
+    ~StateArchive();
+
+    /// Return the hash of the ROM of the states in the archive.
+    u64 rom_hash() { return romHash; }
+
+    /// Return the number of keys in the archive.
+    u32 size() { return keys.size(); }
+
+    /// Return the keys in the order they were first added.
+    const std::vector<u64>& get_keys() { return keys; }
+
+    /// Return true if the archive has a key.
+    bool contains(u64 key) { return index.count(key) > 0; }
+
+    /**
+        Append a record to the archive.
+
+        @param key the key of the record
+        @param state the serialized machine state
+        @param metadata the metadata of the record
+        @param metadata_size the size of the metadata in bytes
+        @param replace whether to replace an existing record with the key
+        @returns true if the record was appended. false if the key exists
+        and replace is false, or if the write failed
+    */
+    bool append(u64 key, const std::vector<u8>& state,
+        const u8* metadata, u32 metadata_size, bool replace);
+
+    /**
+        Find the state of a key.
+
+        @param key the key to find
+        @param state the pointer to set to the serialized state
+        @param size the size of the state in bytes
+        @returns false if the archive doesn't have the key
+    */
+    bool state(u64 key, const u8** state, u32* size);
+
+    /**
+        Copy the metadata of a key.
+
+        @param key the key to find
+        @param output the buffer to copy the metadata to
+        @param capacity the size of the buffer in bytes
+        @returns the size of the metadata (copied if it fits), or -1 if the
+        archive doesn't have the key
+    */
+    s64 metadata(u64 key, u8* output, u32 capacity);
+};
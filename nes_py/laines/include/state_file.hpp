@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include "common.hpp"
+
+/**
+    A save-state file: a little-endian header with a version and the hash
+    of the ROM, followed by the serialized machine state (see StateWriter).
+    Files are mapped read-only into memory, so every process on a machine
+    loading the same file shares its pages.
+*/
+class StateFile {
+private:
+    /// the bytes of the file
+    const u8* data;
+    /// the number of bytes in the file
+    size_t size;
+    /// the bytes of the file when it can't be memory mapped
+    std::vector<u8> buffer;
+
+    /// Initialize a new state file without any data.
+    StateFile() : data(nullptr), size(0) { }
+
+public:
+    /// the size of the header in bytes
+    static const size_t HEADER_SIZE = 24;
+
+    /**
+        Write a save-state file.
+
+        @param path the path of the file to write
+        @param rom_hash the hash of the ROM the state is for
+        @param state the serialized machine state
+        @returns true if the file was written
+    */
+    static bool write(const char* path, u64 rom_hash, const std::vector<u8>& state);
+
+    /**
+        Open and validate a save-state file.
+
+        @param path the path of the file to open
+        @returns the file, or nullptr if it can't be read or isn't a valid
+        save-state file of this version
+    */
+    static StateFile* open(const char* path);
+
+    /// Unmap the file.
+    ~StateFile();
+
+    /// Return the hash of the ROM the state is for.
+    u64 rom_hash();
+
+    /// Return the serialized machine state.
+    const u8* state() { return data + HEADER_SIZE; }
+
+    /// Return the size of the serialized machine state in bytes.
+    size_t state_size() { return size - HEADER_SIZE; }
+};
@@ -0,0 +1,93 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+#include "common.hpp"
+
+/// A stream to serialize machine state into little-endian bytes.
+class StateWriter {
+public:
+    /// the serialized bytes
+    std::vector<u8> data;
+
+    /**
+        Write an integer or boolean in little-endian byte order.
+
+        @param value the value to write to the stream
+    */
+    template<typename T> void write(T value) {
+        u64 bits = static_cast<u64>(value);
+        for (unsigned i = 0; i < sizeof(T); i++)
+            data.push_back((bits >> (8 * i)) & 0xFF);
+    }
+
+    /**
+        Write an array of bytes.
+
+        @param bytes the bytes to write to the stream
+        @param size the number of bytes to write
+    */
+    void write(const u8* bytes, size_t size) {
+        data.insert(data.end(), bytes, bytes + size);
+    }
+};
+
+/// A stream to deserialize machine state from little-endian bytes.
+class StateReader {
+private:
+    /// the serialized bytes
+    const u8* data;
+    /// the number of serialized bytes
+    size_t size;
+    /// the offset of the next byte to read
+    size_t position;
+    /// whether a read went past the end of the data
+    bool failed;
+
+public:
+    /**
+        Initialize a new state reader.
+
+        @param data the serialized bytes to read from
+        @param size the number of serialized bytes
+    */
+    StateReader(const u8* data, size_t size) :
+        data(data), size(size), position(0), failed(false) { }
+
+    /**
+        Read an integer or boolean in little-endian byte order.
+
+        @returns the value read from the stream, or 0 past the end
+    */
+    template<typename T> T read() {
+        if (position + sizeof(T) > size) {
+            failed = true;
+            return T();
+        }
+        u64 bits = 0;
+        for (unsigned i = 0; i < sizeof(T); i++)
+            bits |= static_cast<u64>(data[position++]) << (8 * i);
+        return static_cast<T>(bits);
+    }
+
+    /**
+        Read an array of bytes.
+
+        @param bytes the buffer to read the bytes into
+        @param count the number of bytes to read
+    */
+    void read(u8* bytes, size_t count) {
+        if (position + count > size) {
+            failed = true;
+            return;
+        }
+        std::copy(data + position, data + position + count, bytes);
+        position += count;
+    }
+
+    /// Return the number of bytes left to read.
+    size_t remaining() { return size - position; }
+
+    /// Return true if every read so far was within the data.
+    bool good() { return !failed; }
+};
@@ -0,0 +1,89 @@
+#pragma once
+#include <vector>
+#include "common.hpp"
+
+/// A write to a watched address (laid out for the Python API).
+struct WatchEvent {
+    /// the frame of the write, counted from the last drain
+    u32 frame;
+    /// the address written (RAM mirrors are folded into $0000-$07FF)
+    u16 address;
+    /// the value at the address before the write
+    u8 old_value;
+    /// the value written
+    u8 value;
+};
+
+/**
+    Watchpoints on CPU writes. A bitmap of the 256-byte pages with any
+    watched address filters writes with a single test before the exact
+    bitmap of addresses is checked. Hits are buffered until drained.
+*/
+class Watchpoints {
+private:
+    /// the pages (address / 256) with any watched address
+    u64 pages[4];
+    /// the watched addresses
+    u64 addresses[0x10000 / 64];
+    /// the number of watched addresses
+    u32 count;
+    /// the writes to watched addresses since the last drain
+    std::vector<WatchEvent> events;
+    /// the number of writes dropped since the last drain (buffer full)
+    u32 dropped;
+    /// the frame of the machine counted from the last drain
+    u32 frame;
+
+public:
+    /// the largest number of writes buffered between drains
+    static const u32 MAX_EVENTS = 4096;
+
+    /// Initialize a new set of watchpoints without any addresses.
+    Watchpoints();
+
+    /**
+        Watch or stop watching an address. A RAM address watches all its
+        mirrors.
+
+        @param address the address to watch
+        @param enabled whether to watch the address
+    */
+    void watch(u16 address, bool enabled);
+
+    /// Return the number of watched addresses.
+    u32 size() { return count; }
+
+    /// Return true if an address (with RAM mirrors folded) is watched.
+    inline bool watching(u16 address) {
+        if (!NTH_BIT(pages[address >> 14], (address >> 8) & 63))
+            return false;
+        return NTH_BIT(addresses[address >> 6], address & 63);
+    }
+
+    /**
+        Record a write to a watched address.
+
+        @param address the address written (RAM mirrors folded)
+        @param old_value the value before the write
+        @param value the value written
+    */
+    inline void hit(u16 address, u8 old_value, u8 value) {
+        if (events.size() >= MAX_EVENTS) {
+            dropped++;
+            return;
+        }
+        events.push_back({frame, address, old_value, value});
+    }
+
+    /// Count a frame of the machine.
+    void end_frame() { frame++; }
+
+    /**
+        Copy the buffered writes to an output buffer and clear them.
+
+        @param output the buffer of at least MAX_EVENTS events to fill
+        @param dropped the number of writes dropped since the last drain
+        @returns the number of events copied
+    */
+    u32 drain(WatchEvent* output, u32* dropped);
+};
@@ -0,0 +1,42 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/// A thread that runs one job at a time in the background.
+class Worker {
+private:
+    /// the mutex protecting the job and flags
+    std::mutex mutex;
+    /// the condition to signal new jobs and finished jobs
+    std::condition_variable condition;
+    /// the current job for the thread to run
+    std::function<void()> job;
+    /// whether the thread has a job that hasn't finished
+    bool busy;
+    /// whether the thread should exit
+    bool stopping;
+    /// the background thread
+    std::thread thread;
+
+    /// Run jobs on the background thread until stopped.
+    void run();
+
+public:
+    /// Initialize a new worker and start its thread.
+    Worker();
+
+    /// Finish the current job and join the thread.
+    ~Worker();
+
+    /**
+        Run a job on the background thread. Waits for the previous job.
+
+        @param new_job the function to run on the background thread
+    */
+    void submit(std::function<void()> new_job);
+
+    /// Block until the current job finishes.
+    void wait();
+};
@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <cstdio>
+#include "input_log.hpp"
+
+/// the magic bytes at the start of an input log file
+static const u8 MAGIC[4] = {'N', 'E', 'S', 'L'};
+/// the version of the input log file format
+static const u32 VERSION = 2;
+
+InputLog::InputLog(u32 keyframe_interval, u64 rom_hash) :
+    keyframe_interval(keyframe_interval), rom_hash(rom_hash) { }
+
+u32 InputLog::get_frames() {
+    return inputs.size() / NUM_PORTS;
+}
+
+u32 InputLog::get_keyframe_interval() {
+    return keyframe_interval;
+}
+
+u64 InputLog::get_rom_hash() {
+    return rom_hash;
+}
+
+u8 InputLog::get_buttons(u32 frame, int port) {
+    return inputs[frame * NUM_PORTS + port];
+}
+
+void InputLog::append(const u8* buttons) {
+    inputs.insert(inputs.end(), buttons, buttons + NUM_PORTS);
+}
+
+void InputLog::add_keyframe(std::vector<u8>& state) {
+    keyframes.push_back(Keyframe());
+    keyframes.back().frame = get_frames();
+    keyframes.back().state.swap(state);
+}
+
+const Keyframe* InputLog::nearest_keyframe(u32 frame) {
+    // find the first keyframe after the frame and step back one
+    auto after = std::upper_bound(keyframes.begin(), keyframes.end(), frame,
+        [](u32 f, const Keyframe& keyframe) { return f < keyframe.frame; }
+    );
+    if (after == keyframes.begin())
+        return nullptr;
+    return &*(after - 1);
+}
+
+const Keyframe* InputLog::keyframe_at(u32 frame) {
+    const Keyframe* keyframe = nearest_keyframe(frame);
+    if (keyframe == nullptr || keyframe->frame != frame)
+        return nullptr;
+    return keyframe;
+}
+
+bool InputLog::write(const char* path) {
+    StateWriter stream;
+    // write the header
+    stream.write(MAGIC, sizeof(MAGIC));
+    stream.write(VERSION);
+    stream.write<u32>(NUM_PORTS);
+    stream.write(rom_hash);
+    stream.write(keyframe_interval);
+    stream.write(get_frames());
+    stream.write<u32>(keyframes.size());
+    // write the inputs and keyframes
+    stream.write(inputs.data(), inputs.size());
+    for (auto& keyframe : keyframes) {
+        stream.write(keyframe.frame);
+        stream.write<u32>(keyframe.state.size());
+        stream.write(keyframe.state.data(), keyframe.state.size());
+    }
+    // write the stream to the file
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr)
+        return false;
+    bool written = fwrite(stream.data.data(), 1, stream.data.size(), file) == stream.data.size();
+    // buffered data is only flushed (and can only fail) when closing
+    return fclose(file) == 0 && written;
+}
+
+InputLog* InputLog::read(const char* path) {
+    // read the whole file into memory
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr)
+        return nullptr;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    std::vector<u8> data(size > 0 ? size : 0);
+    size_t count = fread(data.data(), 1, data.size(), file);
+    fclose(file);
+    if (count != data.size())
+        return nullptr;
+    StateReader stream(data.data(), data.size());
+    // read and validate the header
+    u8 magic[4];
+    stream.read(magic, sizeof(magic));
+    if (!stream.good() || !std::equal(magic, magic + 4, MAGIC))
+        return nullptr;
+    if (stream.read<u32>() != VERSION || stream.read<u32>() != NUM_PORTS)
+        return nullptr;
+    u64 rom_hash = stream.read<u64>();
+    InputLog* log = new InputLog(stream.read<u32>(), rom_hash);
+    u32 frames = stream.read<u32>();
+    u32 num_keyframes = stream.read<u32>();
+    // read the inputs and keyframes (sizes are checked before allocating)
+    bool valid = static_cast<u64>(frames) * NUM_PORTS <= stream.remaining();
+    if (valid) {
+        log->inputs.resize(frames * NUM_PORTS);
+        stream.read(log->inputs.data(), log->inputs.size());
+    }
+    for (u32 i = 0; i < num_keyframes && valid; i++) {
+        Keyframe keyframe;
+        keyframe.frame = stream.read<u32>();
+        u32 length = stream.read<u32>();
+        valid = stream.good() && length <= stream.remaining();
+        if (!valid)
+            break;
+        keyframe.state.resize(length);
+        stream.read(keyframe.state.data(), length);
+        log->keyframes.push_back(keyframe);
+    }
+    if (!valid || !stream.good()) {
+        delete log;
+        return nullptr;
+    }
+    return log;
+}
@@ -26,6 +26,10 @@ void Joypad::write_buttons(int n, u8 buttons) {
     this->joypad_buttons[n] = buttons;
 }
 
+u8 Joypad::get_buttons(int n) {
+    return this->joypad_buttons[n];
+}
+
 u8 Joypad::read_state(int n) {
     // When strobe is high, it keeps reading A:
     if (this->strobe)
@@ -45,3 +49,15 @@ void Joypad::write_strobe(bool v) {
 
     this->strobe = v;
 }
+
+void Joypad::serialize(StateWriter& stream) {
+    stream.write(joypad_buttons, NUM_JOYPADS);
+    stream.write(joypad_bits, NUM_JOYPADS);
+    stream.write(strobe);
+}
+
+void Joypad::deserialize(StateReader& stream) {
+    stream.read(joypad_buttons, NUM_JOYPADS);
+    stream.read(joypad_bits, NUM_JOYPADS);
+    strobe = stream.read<bool>();
+}
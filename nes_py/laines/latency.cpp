@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <thread>
+#include "latency.hpp"
+
+#if defined(_WIN32)
+    #include <process.h>
+    #define getpid _getpid
+#else
+    #include <unistd.h>
+#endif
+
+int LatencyHistogram::bucket(u64 value) {
+    if (value < SUB_BUCKETS)
+        return value;
+    // the position of the leading bit of the value
+    int exponent = SUB_BUCKET_BITS;
+    while (exponent < 63 && (value >> (exponent + 1)))
+        exponent++;
+    if (exponent > MAX_EXPONENT)
+        return BUCKETS - 1;
+    int shift = exponent - SUB_BUCKET_BITS;
+    return (shift + 1) * SUB_BUCKETS + static_cast<int>((value >> shift) - SUB_BUCKETS);
+}
+
+u64 LatencyHistogram::midpoint(int index) {
+    if (index < SUB_BUCKETS)
+        return index;
+    int shift = index / SUB_BUCKETS - 1;
+    u64 lower = static_cast<u64>(index % SUB_BUCKETS + SUB_BUCKETS) << shift;
+    return lower + ((1ull << shift) >> 1);
+}
+
+void LatencyHistogram::reset() {
+    memset(counts, 0, sizeof(counts));
+    total = sum = maximum = 0;
+}
+
+u64 LatencyHistogram::percentile(double percent) {
+    if (total == 0)
+        return 0;
+    // the rank of the value at the percentile (at least the first value)
+    u64 rank = static_cast<u64>(std::ceil(percent / 100.0 * total));
+    if (rank < 1)
+        rank = 1;
+    u64 seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        seen += counts[i];
+        if (seen >= rank)
+            return std::min(midpoint(i), maximum);
+    }
+    return maximum;
+}
+
+namespace Trace {
+    /// the names of the operations in the timeline
+    const char* NAMES[NUM_LATENCY_OPS] = { "step", "backup", "restore", "screen" };
+    /// the largest number of events to buffer (later events are dropped)
+    const size_t MAX_EVENTS = 1 << 20;
+
+    /// A finished operation in the timeline.
+    struct Event {
+        /// the operation
+        LatencyOp op;
+        /// the identifier of the environment
+        u32 env;
+        /// the identifier of the thread the operation ran on
+        u32 thread;
+        /// the start of the operation in nanoseconds since the trace started
+        s64 start;
+        /// the duration of the operation in nanoseconds
+        s64 duration;
+    };
+
+    /// whether a timeline is being recorded
+    std::atomic<bool> recording(false);
+    /// the mutex protecting the events and thread identifiers
+    std::mutex mutex;
+    /// the time the timeline started
+    std::chrono::steady_clock::time_point origin;
+    /// the events in the timeline
+    std::vector<Event> events;
+    /// the number of events dropped after the buffer filled
+    u64 dropped;
+    /// small sequential identifiers for the threads in the timeline
+    std::map<std::thread::id, u32> threads;
+
+    void start() {
+        std::lock_guard<std::mutex> lock(mutex);
+        events.clear();
+        threads.clear();
+        dropped = 0;
+        origin = std::chrono::steady_clock::now();
+        recording = true;
+    }
+
+    bool enabled() { return recording.load(std::memory_order_relaxed); }
+
+    void record(LatencyOp op, u32 env,
+        std::chrono::steady_clock::time_point start,
+        std::chrono::steady_clock::time_point end) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!recording)
+            return;
+        if (events.size() >= MAX_EVENTS) {
+            dropped++;
+            return;
+        }
+        auto id = std::this_thread::get_id();
+        auto thread = threads.find(id);
+        if (thread == threads.end())
+            thread = threads.emplace(id, threads.size() + 1).first;
+        Event event;
+        event.op = op;
+        event.env = env;
+        event.thread = thread->second;
+        event.start = std::chrono::duration_cast<std::chrono::nanoseconds>(start - origin).count();
+        event.duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        events.push_back(event);
+    }
+
+    bool stop(const char* path) {
+        std::lock_guard<std::mutex> lock(mutex);
+        recording = false;
+        if (path == nullptr)
+            return false;
+        FILE* file = fopen(path, "w");
+        if (file == nullptr)
+            return false;
+        int pid = getpid();
+        fprintf(file, "{\"displayTimeUnit\": \"ns\", \"otherData\": {\"dropped\": %llu},\n"
+            "\"traceEvents\": [\n", (unsigned long long) dropped);
+        const char* separator = "";
+        // name each thread so workers are easy to tell apart
+        for (auto& thread : threads) {
+            fprintf(file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, "
+                "\"tid\": %u, \"args\": {\"name\": \"nes thread %u\"}}",
+                separator, pid, thread.second, thread.second);
+            separator = ",\n";
+        }
+        for (const Event& event : events) {
+            // timestamps are in microseconds
+            fprintf(file, "%s{\"name\": \"%s\", \"cat\": \"nes\", \"ph\": \"X\", "
+                "\"ts\": %.3f, \"dur\": %.3f, \"pid\": %d, \"tid\": %u, "
+                "\"args\": {\"env\": %u}}",
+                separator, NAMES[event.op], event.start / 1000.0,
+                event.duration / 1000.0, pid, event.thread, event.env);
+            separator = ",\n";
+        }
+        fprintf(file, "\n]}\n");
+        events.clear();
+        threads.clear();
+        return fclose(file) == 0;
+    }
+}
@@ -1,7 +1,22 @@
+#include "cpu.hpp"
 #include "ppu.hpp"
 #include "mapper.hpp"
 
-Mapper::Mapper(u8* rom) : rom(rom) {
+std::unordered_map<u64, std::weak_ptr<ChrCache>> Mapper::romCaches;
+std::mutex Mapper::romCachesLock;
+
+std::shared_ptr<ChrCache> Mapper::rom_cache(u64 hash, u32 size) {
+    std::lock_guard<std::mutex> lock(romCachesLock);
+    // share the cache while any mapper of the ROM is alive
+    std::shared_ptr<ChrCache> cache = romCaches[hash].lock();
+    if (cache == nullptr) {
+        cache = std::make_shared<ChrCache>(size);
+        romCaches[hash] = cache;
+    }
+    return cache;
+}
+
+Mapper::Mapper(u8* rom) : rom(rom, std::default_delete<u8[]>()) {
     // Read infos from header:
     prgSize = rom[4] * 0x4000;
     chrSize = rom[5] * 0x2000;
@@ -9,7 +24,6 @@ Mapper::Mapper(u8* rom) : rom(rom) {
     PPU::set_mirroring((rom[6] & 1) ? VERTICAL : HORIZONTAL);
 
     prg = rom + 16;
-    prgRam = new u8[prgRamSize];
 
     // CHR ROM:
     if (chrSize) {
@@ -21,41 +35,40 @@ Mapper::Mapper(u8* rom) : rom(rom) {
     else {
         chrRam = true;
         chrSize = 0x2000;
-        chr = new u8[chrSize];
         // calculate the ROM size
         romSize = (rom + 16 + prgSize) - rom;
     }
+    allocate_ram();
+    memset(prgRam, 0, prgRamSize + (chrRam ? chrSize : 0));
+    romHash = hash_bytes(rom, romSize);
+    // CHR ROM is decoded once for every instance of the ROM, whereas the
+    // cache of CHR RAM is created on the first render (see cache)
+    if (!chrRam)
+        chrCache = rom_cache(romHash, chrSize);
 }
 
 Mapper::Mapper(Mapper* mapper) {
-    // copy the ROM size and create a new array to store its data in
+    // share the ROM (PRG-ROM and CHR-ROM are read-only, see write_chr)
+    rom = mapper->rom;
     romSize = mapper->romSize;
-    rom = new u8[romSize];
-    // copy the ROM data
-    memcpy(rom, mapper->rom, romSize * sizeof(u8));
+    romHash = mapper->romHash;
     // copy the flag for whether the mapper has CHR RAM
     chrRam = mapper->chrRam;
     // setup the PRG ROM
     prgSize = mapper->prgSize;
-    prg = rom + 16;
+    prg = rom.get() + 16;
     // setup the CHR ROM/RAM
     chrSize = mapper->chrSize;
-    // CHR RAM:
-    if (chrRam) {
-        chr = new u8[chrSize];
-        memcpy(chr, mapper->chr, chrSize * sizeof(u8));
-    }
-    // CHR ROM:
-    else {
-        chr = rom + 16 + prgSize;
-    }
-    // setup the PRG RAM
     prgRamSize = mapper->prgRamSize;
-    prgRam = new u8[prgRamSize];
-    memcpy(prgRam, mapper->prgRam, prgRamSize * sizeof(u8));
-    // copy the maps
-    std::copy(std::begin(mapper->prgMap), std::end(mapper->prgMap), std::begin(prgMap));
-    std::copy(std::begin(mapper->chrMap), std::end(mapper->chrMap), std::begin(chrMap));
+    // CHR ROM (the decoded tiles are shared), a copy with CHR RAM creates
+    // its cache on the first render, so backups never allocate one
+    if (!chrRam) {
+        chr = rom.get() + 16 + prgSize;
+        chrCache = mapper->chrCache;
+    }
+    allocate_ram();
+    // copy the PRG RAM, CHR RAM, and maps
+    Mapper::assign(mapper);
 }
 
 Mapper* Mapper::copy() {
@@ -63,16 +76,35 @@ Mapper* Mapper::copy() {
 }
 
 Mapper::~Mapper() {
-    delete rom;
-    delete prgRam;
+    // the CHR RAM is in the same block as the PRG RAM
+    delete[] prgRam;
+}
+
+void Mapper::allocate_ram() {
+    // one block for the PRG RAM followed by any CHR RAM
+    prgRam = new u8[prgRamSize + (chrRam ? chrSize : 0)];
     if (chrRam)
-        delete chr;
+        chr = prgRam + prgRamSize;
+}
+
+void Mapper::assign(Mapper* mapper) {
+    // the copies share the ROM, so only the RAM and the maps differ
+    memcpy(prgRam, mapper->prgRam, prgRamSize * sizeof(u8));
+    if (chrRam) {
+        memcpy(chr, mapper->chr, chrSize * sizeof(u8));
+        if (chrCache != nullptr)
+            chrCache->invalidate_all();
+    }
+    COUNT_N(snapshot_bytes, prgRamSize + (chrRam ? chrSize : 0));
+    std::copy(std::begin(mapper->prgMap), std::end(mapper->prgMap), std::begin(prgMap));
+    std::copy(std::begin(mapper->chrMap), std::end(mapper->chrMap), std::begin(chrMap));
+    CPU::invalidate_prg();
 }
 
 /* Access to memory */
 u8 Mapper::read(u16 addr) {
     if (addr >= 0x8000)
-        return prg[prgMap[(addr - 0x8000) / 0x2000] + ((addr - 0x8000) % 0x2000)];
+        return prg[prg_offset(addr)];
     else
         return prgRam[addr - 0x6000];
 }
@@ -81,6 +113,36 @@ u8 Mapper::chr_read(u16 addr) {
     return chr[chrMap[addr / 0x400] + (addr % 0x400)];
 }
 
+/* State serialization */
+void Mapper::serialize(StateWriter& stream) {
+    for (int i = 0; i < 4; i++) stream.write(prgMap[i]);
+    for (int i = 0; i < 8; i++) stream.write(chrMap[i]);
+    stream.write(prgRam, prgRamSize);
+    if (chrRam)
+        stream.write(chr, chrSize);
+}
+
+void Mapper::deserialize(StateReader& stream) {
+    for (int i = 0; i < 4; i++) prgMap[i] = stream.read<u32>();
+    for (int i = 0; i < 8; i++) chrMap[i] = stream.read<u32>();
+    CPU::invalidate_prg();
+    stream.read(prgRam, prgRamSize);
+    if (chrRam) {
+        stream.read(chr, chrSize);
+        if (chrCache != nullptr)
+            chrCache->invalidate_all();
+    }
+}
+
+u8 Mapper::write_chr(u16 addr, u8 v) {
+    // CHR-ROM is shared by the copies of the mapper, so writes are ignored
+    if (!chrRam)
+        return v;
+    if (chrCache != nullptr)
+        chrCache->invalidate(addr);
+    return chr[addr] = v;
+}
+
 /* PRG mapping functions */
 template <int pageKBs> void Mapper::map_prg(int slot, int bank) {
     if (bank < 0)
@@ -88,6 +150,7 @@ template <int pageKBs> void Mapper::map_prg(int slot, int bank) {
 
     for (int i = 0; i < (pageKBs/8); i++)
         prgMap[(pageKBs/8) * slot + i] = (pageKBs*0x400*bank + 0x2000*i) % prgSize;
+    CPU::invalidate_prg();
 }
 template void Mapper::map_prg<32>(int, int);
 template void Mapper::map_prg<16>(int, int);
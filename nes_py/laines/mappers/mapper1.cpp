@@ -3,6 +3,7 @@
 
 /* Apply the registers state */
 void Mapper1::apply() {
+    COUNT(mapper_applies);
     // 16KB PRG:
     if (regs[0] & 0b1000) {
         // 0x8000 swappable, 0xC000 fixed to bank 0x0F:
@@ -42,6 +43,7 @@ u8 Mapper1::write(u16 addr, u8 v) {
         prgRam[addr - 0x6000] = v;
     // Mapper register write:
     else if (addr & 0x8000) {
+        COUNT(mapper_writes);
         // Reset:
         if (v & 0x80) {
             writeN   = 0;
@@ -65,5 +67,19 @@ u8 Mapper1::write(u16 addr, u8 v) {
 }
 
 u8 Mapper1::chr_write(u16 addr, u8 v) {
-    return chr[addr] = v;
+    return write_chr(addr, v);
+}
+
+void Mapper1::serialize(StateWriter& stream) {
+    Mapper::serialize(stream);
+    stream.write(writeN);
+    stream.write(tmpReg);
+    stream.write(regs, sizeof(regs));
+}
+
+void Mapper1::deserialize(StateReader& stream) {
+    Mapper::deserialize(stream);
+    writeN = stream.read<int>();
+    tmpReg = stream.read<u8>();
+    stream.read(regs, sizeof(regs));
 }
@@ -5,6 +5,7 @@
 
 /* Apply the registers state */
 void Mapper2::apply() {
+    COUNT(mapper_applies);
    /*
     * 16 kb PRG ROM Banks
     * 0x8000 - 0xBFFF swappable
@@ -25,6 +26,7 @@ u8 Mapper2::write(u16 addr, u8 v) {
 
     /* bank switching */
     if (addr & 0x8000) {
+        COUNT(mapper_writes);
         regs[0] = v;
         apply();
     }
@@ -32,5 +34,15 @@ u8 Mapper2::write(u16 addr, u8 v) {
 }
 
 u8 Mapper2::chr_write(u16 addr, u8 v) {
-    return chr[addr] = v;
+    return write_chr(addr, v);
+}
+
+void Mapper2::serialize(StateWriter& stream) {
+    Mapper::serialize(stream);
+    stream.write(regs, sizeof(regs));
+}
+
+void Mapper2::deserialize(StateReader& stream) {
+    Mapper::deserialize(stream);
+    stream.read(regs, sizeof(regs));
 }
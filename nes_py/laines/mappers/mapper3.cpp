@@ -5,6 +5,7 @@
 
 /* Apply the registers state */
 void Mapper3::apply() {
+    COUNT(mapper_applies);
     if (PRG_size_16k) {
     /*
      * mirror the bottom on the top
@@ -32,6 +33,7 @@ u8 Mapper3::write(u16 addr, u8 v) {
 
     /* chr bank switching */
     if (addr & 0x8000) {
+        COUNT(mapper_writes);
         regs[0] = v;
         apply();
     }
@@ -39,6 +41,15 @@ u8 Mapper3::write(u16 addr, u8 v) {
 }
 
 u8 Mapper3::chr_write(u16 addr, u8 v) {
-    return chr[addr] = v;
+    return write_chr(addr, v);
 }
 
+void Mapper3::serialize(StateWriter& stream) {
+    Mapper::serialize(stream);
+    stream.write(regs, sizeof(regs));
+}
+
+void Mapper3::deserialize(StateReader& stream) {
+    Mapper::deserialize(stream);
+    stream.read(regs, sizeof(regs));
+}
@@ -3,6 +3,7 @@
 #include "mappers/mapper4.hpp"
 
 void Mapper4::apply() {
+    COUNT(mapper_applies);
     map_prg<8>(1, regs[7]);
 
     // PRG Mode 0:
@@ -38,6 +39,7 @@ u8 Mapper4::write(u16 addr, u8 v) {
     if (addr < 0x8000)
         prgRam[addr - 0x6000] = v;
     else if (addr & 0x8000) {
+        COUNT(mapper_writes);
         switch (addr & 0xE001) {
             case 0x8000:  reg8000 = v;                      break;
             case 0x8001:  regs[reg8000 & 0b111] = v;        break;
@@ -53,7 +55,7 @@ u8 Mapper4::write(u16 addr, u8 v) {
 }
 
 u8 Mapper4::chr_write(u16 addr, u8 v) {
-    return chr[addr] = v;
+    return write_chr(addr, v);
 }
 
 void Mapper4::signal_scanline() {
@@ -65,3 +67,23 @@ void Mapper4::signal_scanline() {
     if (irqEnabled && irqCounter == 0)
         CPU::set_irq();
 }
+
+void Mapper4::serialize(StateWriter& stream) {
+    Mapper::serialize(stream);
+    stream.write(reg8000);
+    stream.write(regs, sizeof(regs));
+    stream.write(horizMirroring);
+    stream.write(irqPeriod);
+    stream.write(irqCounter);
+    stream.write(irqEnabled);
+}
+
+void Mapper4::deserialize(StateReader& stream) {
+    Mapper::deserialize(stream);
+    reg8000 = stream.read<u8>();
+    stream.read(regs, sizeof(regs));
+    horizMirroring = stream.read<bool>();
+    irqPeriod = stream.read<u8>();
+    irqCounter = stream.read<u8>();
+    irqEnabled = stream.read<bool>();
+}
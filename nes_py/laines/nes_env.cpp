@@ -1,47 +1,772 @@
 #include "nes_env.hpp"
+#include <algorithm>
+#include <cmath>
 
-NESEnv::NESEnv(wchar_t* path) {
+NESEnv* NESEnv::active = nullptr;
+std::mutex NESEnv::machine;
+u32 NESEnv::next_id = 0;
+std::unordered_map<u64, std::shared_ptr<ResetState>> NESEnv::reset_states;
+
+void NESEnv::activate() {
+    // this environment's game-state is already in the machine
+    if (active == this)
+        return;
+    // save the game-state of the other environment from the machine
+    deactivate();
+    // load this environment's game-state into the machine
+    current_state->load();
+    PPU::set_gui(gui);
+    PPU::set_output(render);
+    PPU::set_pixel_format(pixel_format);
+    Counters::attach(&hardware_counters);
+    CPU::set_profiler(profiler);
+    CPU::set_watchpoints(watchpoints);
+    active = this;
+}
+
+void NESEnv::deactivate() {
+    if (active == nullptr)
+        return;
+    active->current_state->save();
+    Counters::attach(nullptr);
+    CPU::set_profiler(nullptr);
+    CPU::set_watchpoints(nullptr);
+    active = nullptr;
+}
+
+void NESEnv::initialize() {
+    render = true;
+    pixel_format = PIXEL_RGB;
+    recording = nullptr;
+    keyframe_pending = false;
+    state_size = 0;
+    replay_log = nullptr;
+    replay_frame = 0;
+    hardware_counters = Counters();
+    profiler = nullptr;
+    watchpoints = nullptr;
+    backup_state = nullptr;
+    backup_gui = nullptr;
+    worker = nullptr;
+    step_spec = nullptr;
+    id = next_id++;
+    // lay the CPU, PPU, and joypad states, the framebuffer, and their
+    // backups out in one block (the cartridge and mapper are on the heap)
+    size_t size = Arena::slot<CPUState>() + Arena::slot<PPUState>() +
+        Arena::slot<Joypad>() + Arena::slot<GUI>();
+    arena = new Arena(2 * size);
     // setup the game state
-    current_state = new GameState();
+    current_state = new GameState(
+        arena->make<CPUState>(), arena->make<PPUState>(), arena->make<Joypad>());
+    gui = arena->make<GUI>();
+}
+
+NESEnv::NESEnv(wchar_t* path) {
+    std::lock_guard<std::mutex> lock(machine);
+    // save the active environment before the cartridge changes the machine
+    deactivate();
+    initialize();
     // convert the wchar_t type to a string
     std::wstring ws_rom_path(path);
     std::string rom_path(ws_rom_path.begin(), ws_rom_path.end());
     // initialize a cartridge and load the ROM for it
     current_state->cartridge = new Cartridge(rom_path.c_str());
-    current_state->gui = new GUI();
-    current_state->joypad = new Joypad();
+    // copy the mirroring mode of the cartridge into the PPU state
+    current_state->ppu_state->mirroring = PPU::get_mirroring();
     // set the cartridge pointer for the CPU and PPU
+    activate();
+}
+
+NESEnv::NESEnv(NESEnv* source) {
+    std::lock_guard<std::mutex> lock(machine);
+    initialize();
+    render = source->render;
+    pixel_format = source->pixel_format;
+    // the copy of the cartridge shares the ROM of the source
+    current_state->cartridge = new Cartridge(source->current_state->cartridge);
+    source->activate();
+    StateWriter stream;
+    source->save_state(stream);
+    load_clone(stream.data);
+    // the frame in progress is drawn over the framebuffer of the source
+    *gui = *source->gui;
+    COUNT_N(snapshot_bytes, sizeof(GUI));
+}
+
+NESEnv::~NESEnv() {
+    // finish any asynchronous step before taking the machine
+    delete worker;
+    std::lock_guard<std::mutex> lock(machine);
+    // release the machine if this environment has it loaded
+    if (active == this) {
+        Counters::attach(nullptr);
+        CPU::set_profiler(nullptr);
+        CPU::set_watchpoints(nullptr);
+        active = nullptr;
+    }
+    delete current_state;
+    delete backup_state;
+    delete arena;
+    delete recording;
+    delete profiler;
+    delete watchpoints;
+    delete step_spec;
+}
+
+int NESEnv::run_frame(const RamPredicate* predicate) {
+    if (recording != nullptr) {
+        // keyframe periodically and after changes that aren't from inputs
+        u32 frames = recording->get_frames();
+        if (keyframe_pending || frames % recording->get_keyframe_interval() == 0) {
+            StateWriter stream;
+            save_state(stream);
+            recording->add_keyframe(stream.data);
+            keyframe_pending = false;
+        }
+        u8 buttons[InputLog::NUM_PORTS];
+        for (int port = 0; port < InputLog::NUM_PORTS; port++)
+            buttons[port] = CPU::get_joypad()->get_buttons(port);
+        recording->append(buttons);
+    }
+    // the machine leaves the replayed log once it runs its own frames
+    replay_log = nullptr;
+    int clause = -1;
+    if (predicate != nullptr)
+        clause = CPU::run_frame(*predicate);
+    else
+        CPU::run_frame();
+    if (watchpoints != nullptr)
+        watchpoints->end_frame();
+    return clause;
+}
+
+void NESEnv::state_changed() {
+    keyframe_pending = true;
+    replay_log = nullptr;
+}
+
+void NESEnv::save_state(StateWriter& stream) {
+    current_state->save();
+    size_t start = stream.data.size();
+    current_state->serialize(stream);
+    COUNT_N(snapshot_bytes, stream.data.size() - start);
+}
+
+size_t NESEnv::serialized_size() {
+    // the size of a state doesn't depend on its values, so serialize the
+    // game-state as is instead of activating the environment to save it
+    if (state_size == 0) {
+        StateWriter stream;
+        current_state->serialize(stream);
+        state_size = stream.data.size();
+    }
+    return state_size;
+}
+
+bool NESEnv::load_state(StateReader& stream) {
+    // reject a truncated state before any of it is read into the game-state
+    if (stream.remaining() < serialized_size())
+        return false;
+    // copy the machine into the game-state first so any fields that aren't
+    // in the stream keep their values when the game-state is loaded back
+    current_state->save();
+    size_t start = stream.remaining();
+    bool valid = current_state->deserialize(stream);
+    COUNT_N(snapshot_bytes, start - stream.remaining());
     current_state->load();
-    // set the backup state to NULL
-    backup_state = nullptr;
+    return valid;
 }
 
-void NESEnv::reset() {
+bool NESEnv::load_clone(const std::vector<u8>& state) {
+    activate();
+    state_changed();
+    StateReader stream(state.data(), state.size());
+    return load_state(stream);
+}
+
+bool NESEnv::load_keyframe(const Keyframe* keyframe) {
+    StateReader stream(keyframe->state.data(), keyframe->state.size());
+    return load_state(stream);
+}
+
+bool NESEnv::reset() {
+    std::lock_guard<std::mutex> lock(machine);
+    activate();
+    return reset_machine();
+}
+
+bool NESEnv::reset_machine() {
+    state_changed();
+    auto golden = reset_states.find(current_state->cartridge->rom_hash());
+    if (golden != reset_states.end()) {
+        // load the post-boot state instead of booting again. keep a
+        // reference so the state outlives its removal below
+        std::shared_ptr<ResetState> reset_state = golden->second;
+        StateReader stream(reset_state->state.data(), reset_state->state.size());
+        if (load_state(stream)) {
+            *gui = reset_state->gui;
+            COUNT_N(snapshot_bytes, sizeof(GUI));
+            return true;
+        }
+        // the state doesn't load, so remove it and power on instead
+        reset_states.erase(golden);
+        CPU::power();
+        PPU::reset();
+        return false;
+    }
     // initialize the CPU
     CPU::power();
     // initialize the PPU
     PPU::reset();
+    return true;
+}
+
+void NESEnv::set_reset_state() {
+    std::lock_guard<std::mutex> lock(machine);
+    activate();
+    auto golden = std::make_shared<ResetState>();
+    StateWriter stream;
+    save_state(stream);
+    golden->state.swap(stream.data);
+    golden->gui = *gui;
+    reset_states[current_state->cartridge->rom_hash()] = golden;
+}
+
+bool NESEnv::set_reset_state_file(StateFile* file) {
+    std::lock_guard<std::mutex> lock(machine);
+    if (file->rom_hash() != current_state->cartridge->rom_hash())
+        return false;
+    activate();
+    // load the state once to check it, then put the machine back
+    StateWriter current;
+    save_state(current);
+    StateReader stream(file->state(), file->state_size());
+    bool valid = load_state(stream);
+    StateReader restore(current.data.data(), current.data.size());
+    load_state(restore);
+    if (!valid)
+        return false;
+    auto golden = std::make_shared<ResetState>();
+    golden->state.assign(file->state(), file->state() + file->state_size());
+    reset_states[file->rom_hash()] = golden;
+    return true;
+}
+
+void NESEnv::clear_reset_state() {
+    std::lock_guard<std::mutex> lock(machine);
+    reset_states.erase(current_state->cartridge->rom_hash());
+}
+
+bool NESEnv::has_reset_state() {
+    std::lock_guard<std::mutex> lock(machine);
+    return reset_states.count(current_state->cartridge->rom_hash()) > 0;
 }
 
 void NESEnv::step(unsigned char action) {
+    std::lock_guard<std::mutex> lock(machine);
+    LatencyTimer timer(latencies[STEP], STEP, id);
+    activate();
     // write the action to the player's joy-pad
     CPU::get_joypad()->write_buttons(0, action);
     // run a frame on the CPU
-    CPU::run_frame();
+    run_frame();
+}
+
+u32 NESEnv::run_until(
+    unsigned char action,
+    const RamCondition* conditions,
+    int count,
+    u32 max_frames,
+    bool per_instruction,
+    int* clause
+) {
+    std::lock_guard<std::mutex> lock(machine);
+    activate();
+    CPU::get_joypad()->write_buttons(0, action);
+    RamPredicate predicate(conditions, count);
+    predicate.start(CPU::read_mem);
+    *clause = predicate.test(CPU::read_mem);
+    u32 frames = 0;
+    while (*clause < 0 && frames < max_frames) {
+        if (per_instruction) {
+            *clause = run_frame(&predicate);
+        } else {
+            run_frame();
+            *clause = predicate.test(CPU::read_mem);
+        }
+        frames++;
+    }
+    return frames;
+}
+
+void NESEnv::rollout(
+    const u8* actions,
+    int rollouts,
+    int length,
+    const RewardTerm* terms,
+    int term_count,
+    const RamCondition* done,
+    int done_count,
+    int workers,
+    double* rewards,
+    u32* frames,
+    u8* final_ram
+) {
+    std::lock_guard<std::mutex> lock(machine);
+    activate();
+    StateWriter start;
+    save_state(start);
+    RewardSpec reward(terms, term_count);
+    RamPredicate predicate(done, done_count);
+    auto job = [&](int k, RolloutResult* result) {
+        StateReader stream(start.data.data(), start.data.size());
+        if (!load_state(stream)) {
+            // a rollout that can't start has a NaN reward and no frames
+            result->reward = NAN;
+            result->frames = 0;
+            std::fill(std::begin(result->ram), std::end(result->ram), 0);
+            return;
+        }
+        double value = reward.value(CPU::read_mem);
+        predicate.start(CPU::read_mem);
+        result->reward = 0;
+        result->frames = 0;
+        for (int frame = 0; frame < length; frame++) {
+            CPU::get_joypad()->write_buttons(0, actions[k * length + frame]);
+            CPU::run_frame();
+            double next = reward.value(CPU::read_mem);
+            result->reward += next - value;
+            value = next;
+            result->frames++;
+            if (predicate.test(CPU::read_mem) >= 0)
+                break;
+        }
+        for (int address = 0; address < 0x800; address++)
+            result->ram[address] = CPU::read_mem(address);
+    };
+    PPU::set_output(false);
+    // the frames of the rollouts never happen in the trajectory of the
+    // environment, so they aren't counted, profiled, or watched
+    Counters::attach(nullptr);
+    CPU::set_profiler(nullptr);
+    CPU::set_watchpoints(nullptr);
+    std::vector<RolloutResult> results(rollouts);
+    if (workers <= 1 || !run_forked(rollouts, workers, job, results.data())) {
+        // run the rollouts in this process without workers
+        for (int k = 0; k < rollouts; k++)
+            job(k, &results[k]);
+    }
+    // leave the machine in the state the rollouts started from
+    StateReader stream(start.data.data(), start.data.size());
+    load_state(stream);
+    PPU::set_output(render);
+    Counters::attach(&hardware_counters);
+    CPU::set_profiler(profiler);
+    CPU::set_watchpoints(watchpoints);
+    for (int k = 0; k < rollouts; k++) {
+        rewards[k] = results[k].reward;
+        frames[k] = results[k].frames;
+        std::copy_n(results[k].ram, 0x800, final_ram + k * 0x800);
+    }
+}
+
+void NESEnv::step_batch(
+    NESEnv** envs,
+    int count,
+    const u8* actions,
+    int frames,
+    BatchSpec& spec,
+    double* rewards,
+    u8* dones,
+    double* infos,
+    u8* screens,
+    u8* terminal_screens,
+    u8* ram
+) {
+    std::lock_guard<std::mutex> lock(machine);
+    const int info_count = spec.info.size();
+    const size_t screen_size = GUI::get_width() * GUI::get_height() * 4;
+    for (int i = 0; i < count; i++) {
+        NESEnv* env = envs[i];
+        {
+            LatencyTimer timer(env->latencies[STEP], STEP, env->id);
+            env->activate();
+            CPU::get_joypad()->write_buttons(0, actions[i]);
+            double value = spec.reward.value(CPU::read_mem);
+            spec.done.start(CPU::read_mem);
+            dones[i] = false;
+            for (int frame = 0; frame < frames && !dones[i]; frame++) {
+                env->run_frame();
+                dones[i] = spec.done.test(CPU::read_mem) >= 0;
+            }
+            rewards[i] = spec.reward.value(CPU::read_mem) - value;
+            for (int k = 0; k < info_count; k++)
+                infos[i * info_count + k] = spec.info[k].value(CPU::read_mem);
+        }
+        LatencyTimer timer(env->latencies[SCREEN], SCREEN, env->id);
+        if (dones[i]) {
+            // keep the last screen of the episode and start the next one
+            env->gui->copy_screen(terminal_screens + i * screen_size);
+            // a golden state that fails to load is removed and resets power on
+            env->reset_machine();
+        }
+        env->gui->copy_screen(screens + i * screen_size);
+        if (ram != nullptr)
+            env->read_ram(ram + i * RAM_SIZE, nullptr);
+    }
+}
+
+void NESEnv::read_ram_batch(NESEnv** envs, int count, u8* ram, u8* prg_ram) {
+    std::lock_guard<std::mutex> lock(machine);
+    for (int i = 0; i < count; i++)
+        envs[i]->read_ram(ram + i * RAM_SIZE,
+            prg_ram != nullptr ? prg_ram + i * PRG_RAM_SIZE : nullptr);
+}
+
+void NESEnv::read_ram(u8* ram, u8* prg_ram) {
+    // the RAM of an environment is in the machine while it's active
+    const u8* source = active == this ? CPU::get_ram() : current_state->cpu_state->ram;
+    memcpy(ram, source, RAM_SIZE);
+    if (prg_ram == nullptr)
+        return;
+    Cartridge* cartridge = current_state->cartridge;
+    // only the first 8KB of PRG RAM are in the window at $6000-$7FFF
+    u32 size = cartridge->prg_ram_size();
+    if (size > PRG_RAM_SIZE)
+        size = PRG_RAM_SIZE;
+    memcpy(prg_ram, cartridge->prg_ram(), size);
+    memset(prg_ram + size, 0, PRG_RAM_SIZE - size);
+}
+
+void NESEnv::set_step_spec(BatchSpec* spec) {
+    // the worker may be running a step with the old specification
+    step_wait();
+    delete step_spec;
+    step_spec = spec;
+}
+
+void NESEnv::step_async(unsigned char action, int frames, unsigned char *output_buffer,
+    double* reward, u8* done, double* infos) {
+    if (worker == nullptr)
+        worker = new Worker();
+    worker->submit([this, action, frames, output_buffer, reward, done, infos] {
+        std::lock_guard<std::mutex> lock(machine);
+        {
+            LatencyTimer timer(latencies[STEP], STEP, id);
+            activate();
+            CPU::get_joypad()->write_buttons(0, action);
+            if (step_spec == nullptr) {
+                for (int frame = 0; frame < frames; frame++)
+                    run_frame();
+            } else {
+                // test the done predicate between frames like step_batch
+                BatchSpec& spec = *step_spec;
+                double value = spec.reward.value(CPU::read_mem);
+                spec.done.start(CPU::read_mem);
+                *done = false;
+                for (int frame = 0; frame < frames && !*done; frame++) {
+                    run_frame();
+                    *done = spec.done.test(CPU::read_mem) >= 0;
+                }
+                *reward = spec.reward.value(CPU::read_mem) - value;
+                for (size_t k = 0; k < spec.info.size(); k++)
+                    infos[k] = spec.info[k].value(CPU::read_mem);
+            }
+        }
+        LatencyTimer timer(latencies[SCREEN], SCREEN, id);
+        gui->copy_screen(output_buffer);
+    });
+}
+
+void NESEnv::step_wait() {
+    if (worker != nullptr)
+        worker->wait();
+}
+
+void NESEnv::set_render(bool enabled) {
+    std::lock_guard<std::mutex> lock(machine);
+    render = enabled;
+    if (active == this)
+        PPU::set_output(render);
+}
+
+void NESEnv::set_pixel_format(PixelFormat format) {
+    std::lock_guard<std::mutex> lock(machine);
+    pixel_format = format;
+    if (active == this)
+        PPU::set_pixel_format(pixel_format);
+}
+
+void NESEnv::observe(SymbolicObservation* observation) {
+    std::lock_guard<std::mutex> lock(machine);
+    activate();
+    PPU::observe(observation);
+}
+
+void NESEnv::record(u32 keyframe_interval) {
+    std::lock_guard<std::mutex> lock(machine);
+    delete recording;
+    recording = new InputLog(keyframe_interval > 0 ? keyframe_interval : 1,
+        current_state->cartridge->rom_hash());
+}
+
+bool NESEnv::stop_recording(const char* path) {
+    std::lock_guard<std::mutex> lock(machine);
+    if (recording == nullptr)
+        return false;
+    bool written = path != nullptr && recording->write(path);
+    delete recording;
+    recording = nullptr;
+    return written;
+}
+
+bool NESEnv::seek(InputLog* log, u32 frame) {
+    std::lock_guard<std::mutex> lock(machine);
+    if (log->get_rom_hash() != current_state->cartridge->rom_hash())
+        return false;
+    activate();
+    if (frame > log->get_frames())
+        return false;
+    // a screen is drawn across two calls to run_frame, so start at least two
+    // frames back to render the whole screen
+    const Keyframe* keyframe = log->nearest_keyframe(frame > 2 ? frame - 2 : 0);
+    // continue from the current position unless a keyframe is closer
+    bool resume = replay_log == log && replay_frame <= frame &&
+        (keyframe == nullptr || keyframe->frame <= replay_frame);
+    if (!resume) {
+        if (keyframe == nullptr || !load_keyframe(keyframe))
+            return false;
+        replay_frame = keyframe->frame;
+    }
+    state_changed();
+    // re-simulate the frames with only the last two rendered
+    for (u32 f = replay_frame; f < frame; f++) {
+        // jump to keyframes on the way (e.g., resets that aren't inputs)
+        const Keyframe* next = log->keyframe_at(f);
+        if (f > replay_frame && next != nullptr && !load_keyframe(next))
+            return false;
+        for (int port = 0; port < InputLog::NUM_PORTS; port++)
+            CPU::get_joypad()->write_buttons(port, log->get_buttons(f, port));
+        PPU::set_output(render && f + 2 >= frame);
+        CPU::run_frame();
+    }
+    PPU::set_output(render);
+    replay_log = log;
+    replay_frame = frame;
+    return true;
+}
+
+void NESEnv::save_snapshot(StateWriter& stream) {
+    std::lock_guard<std::mutex> lock(machine);
+    activate();
+    save_state(stream);
+}
+
+bool NESEnv::load_snapshot(StateReader& stream) {
+    std::lock_guard<std::mutex> lock(machine);
+    activate();
+    state_changed();
+    return load_state(stream);
+}
+
+bool NESEnv::broadcast(NESEnv** targets, int count) {
+    std::lock_guard<std::mutex> lock(machine);
+    u64 hash = current_state->cartridge->rom_hash();
+    for (int i = 0; i < count; i++)
+        if (targets[i]->current_state->cartridge->rom_hash() != hash)
+            return false;
+    activate();
+    StateWriter stream;
+    save_state(stream);
+    bool loaded = true;
+    for (int i = 0; i < count; i++) {
+        if (targets[i] == this)
+            continue;
+        loaded &= targets[i]->load_clone(stream.data);
+        // the frame in progress is drawn over the framebuffer of the source
+        *targets[i]->gui = *gui;
+        COUNT_N(snapshot_bytes, sizeof(GUI));
+    }
+    return loaded;
+}
+
+u64 NESEnv::rom_hash() {
+    std::lock_guard<std::mutex> lock(machine);
+    return current_state->cartridge->rom_hash();
+}
+
+bool NESEnv::save_state_file(const char* path) {
+    std::lock_guard<std::mutex> lock(machine);
+    activate();
+    StateWriter stream;
+    save_state(stream);
+    return StateFile::write(path, current_state->cartridge->rom_hash(), stream.data);
+}
+
+bool NESEnv::load_state_file(StateFile* file) {
+    std::lock_guard<std::mutex> lock(machine);
+    if (file->rom_hash() != current_state->cartridge->rom_hash())
+        return false;
+    activate();
+    state_changed();
+    StateReader stream(file->state(), file->state_size());
+    return load_state(stream);
+}
+
+bool NESEnv::archive_state(StateArchive* archive, u64* key, bool hash_key,
+    const u8* metadata, u32 metadata_size, bool replace) {
+    std::lock_guard<std::mutex> lock(machine);
+    if (archive->rom_hash() != current_state->cartridge->rom_hash())
+        return false;
+    activate();
+    StateWriter stream;
+    save_state(stream);
+    if (hash_key)
+        *key = hash_bytes(stream.data.data(), stream.data.size());
+    return archive->append(*key, stream.data, metadata, metadata_size, replace);
+}
+
+bool NESEnv::restore_archived(StateArchive* archive, u64 key) {
+    std::lock_guard<std::mutex> lock(machine);
+    const u8* state;
+    u32 size;
+    if (archive->rom_hash() != current_state->cartridge->rom_hash() ||
+        !archive->state(key, &state, &size))
+        return false;
+    activate();
+    state_changed();
+    StateReader stream(state, size);
+    return load_state(stream);
+}
+
+void NESEnv::get_counters(Counters* output) {
+    std::lock_guard<std::mutex> lock(machine);
+    *output = hardware_counters;
+}
+
+void NESEnv::footprint(MemoryFootprint* output) {
+    std::lock_guard<std::mutex> lock(machine);
+    output->instance = sizeof(NESEnv);
+    output->state = current_state->footprint();
+    output->backup = 0;
+    if (backup_state != nullptr)
+        output->backup = backup_state->footprint() + sizeof(GUI);
+    output->framebuffer = sizeof(GUI);
+    output->serialized = serialized_size();
+    output->shared = current_state->cartridge->shared_footprint();
+}
+
+void NESEnv::reset_counters() {
+    std::lock_guard<std::mutex> lock(machine);
+    hardware_counters = Counters();
+}
+
+void NESEnv::profile(u32 interval) {
+    std::lock_guard<std::mutex> lock(machine);
+    activate();
+    delete profiler;
+    profiler = new Profiler(CPU::get_cartridge()->prg_size(), interval);
+    CPU::set_profiler(profiler);
+}
+
+bool NESEnv::stop_profile(const char* path) {
+    std::lock_guard<std::mutex> lock(machine);
+    if (profiler == nullptr)
+        return false;
+    bool written = path != nullptr && profiler->dump(path);
+    if (active == this)
+        CPU::set_profiler(nullptr);
+    delete profiler;
+    profiler = nullptr;
+    return written;
+}
+
+bool NESEnv::watch(u16 address, bool enabled) {
+    // only RAM and PRG-RAM have an old value to report for a write
+    if (!(address <= 0x1FFF || (0x6000 <= address && address <= 0x7FFF)))
+        return false;
+    std::lock_guard<std::mutex> lock(machine);
+    if (watchpoints == nullptr) {
+        watchpoints = new Watchpoints();
+        if (active == this)
+            CPU::set_watchpoints(watchpoints);
+    }
+    watchpoints->watch(address, enabled);
+    return true;
+}
+
+u32 NESEnv::watch_events(WatchEvent* output, u32* dropped) {
+    std::lock_guard<std::mutex> lock(machine);
+    if (watchpoints == nullptr) {
+        *dropped = 0;
+        return 0;
+    }
+    return watchpoints->drain(output, dropped);
+}
+
+void NESEnv::latency(LatencyOp op, const double* percents, int count, double* output) {
+    std::lock_guard<std::mutex> lock(machine);
+    LatencyHistogram& histogram = latencies[op];
+    output[0] = histogram.count();
+    output[1] = histogram.mean();
+    output[2] = histogram.max();
+    for (int i = 0; i < count; i++)
+        output[3 + i] = histogram.percentile(percents[i]);
+}
+
+void NESEnv::reset_latency() {
+    std::lock_guard<std::mutex> lock(machine);
+    for (LatencyHistogram& histogram : latencies)
+        histogram.reset();
 }
 
 void NESEnv::backup() {
-    // delete any current backup
-    delete backup_state;
+    std::lock_guard<std::mutex> lock(machine);
+    LatencyTimer timer(latencies[BACKUP], BACKUP, id);
+    activate();
+    current_state->save();
+    // the first backup takes the rest of the arena, later ones reuse it
+    if (backup_state == nullptr) {
+        backup_state = new GameState(
+            arena->make<CPUState>(), arena->make<PPUState>(), arena->make<Joypad>());
+        backup_state->cartridge = new Cartridge(current_state->cartridge);
+        backup_gui = arena->make<GUI>();
+    }
     // copy the current state as the backup state
-    backup_state = new GameState(current_state, CPU::get_state(), PPU::get_state());
+    backup_state->copy(current_state);
+    // keep the framebuffer so the restored screen matches the backup
+    *backup_gui = *gui;
 }
 
 void NESEnv::restore() {
-    // delete the current state in progress
-    delete current_state;
-    // copy the backup state into the current state
-    current_state = new GameState(backup_state);
+    std::lock_guard<std::mutex> lock(machine);
+    LatencyTimer timer(latencies[RESTORE], RESTORE, id);
+    // release the machine if this environment has it loaded
+    if (active == this)
+        active = nullptr;
+    // copy the backup state over the current state in progress
+    current_state->copy(backup_state);
+    *gui = *backup_gui;
     // load the current state into the machine
-    current_state->load();
+    activate();
+    state_changed();
+}
+
+u8 NESEnv::read_mem(u16 address) {
+    std::lock_guard<std::mutex> lock(machine);
+    activate();
+    return CPU::read_mem(address);
+}
+
+void NESEnv::write_mem(u16 address, u8 value) {
+    std::lock_guard<std::mutex> lock(machine);
+    activate();
+    state_changed();
+    CPU::write_mem(address, value);
+}
+
+void NESEnv::screen(unsigned char *output_buffer) {
+    std::lock_guard<std::mutex> lock(machine);
+    LatencyTimer timer(latencies[SCREEN], SCREEN, id);
+    gui->copy_screen(output_buffer);
 }
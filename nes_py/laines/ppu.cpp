@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstring>
 #include "cpu.hpp"
 #include "ppu.hpp"
@@ -14,8 +15,30 @@ namespace PPU {
     u8 oamMem[0x100];
     /// Sprite buffers
     Sprite oam[8], secOam[8];
-    /// Video buffer
-    u32 pixels[256 * 240];
+    /// The sprites on each visible scanline (bit i for OAM sprite i)
+    u64 spriteRows[240];
+    /// The Y coordinate each sprite is indexed at in the scanline rows
+    u8 indexedY[64];
+    /// The sprite height the scanline rows are indexed with
+    int indexedHeight;
+    /// The composited sprite pixels of the line in primary OAM: the palette
+    /// index (16-31, 0 if transparent) and the flags below
+    u8 spriteLine[256];
+    /// The sprite line flag for sprites behind the background
+    const u8 SPRITE_BEHIND = 0x20;
+    /// The sprite line flag for an opaque pixel of sprite 0
+    const u8 SPRITE_ZERO = 0x40;
+    /// Whether the sprite line needs to be rebuilt from primary OAM
+    bool spriteLineDirty = true;
+    /// The decoded (and flipped) pixels of the sprites in primary OAM
+    u64 spritePixels[8];
+    /// Video buffer (in the GUI of the loaded environment)
+    u32* pixels;
+    /// The format of the pixels in the video buffer
+    PixelFormat pixelFormat = PIXEL_RGB;
+    /// The output color of each palette entry with mirroring, grayscale,
+    /// and the pixel format resolved (updated when any of them change)
+    u32 resolvedPalette[0x20];
 
     /// Loopy V, T
     Addr vAddr, tAddr;
@@ -41,12 +64,25 @@ namespace PPU {
     int scanline, dot;
     bool frameOdd;
 
+    /// Result of the operation
+    u8 res;
+    /// VRAM read buffer
+    u8 buffer;
+    /// Detect second reading
+    bool latch;
+    /// Address of the current background fetch
+    u16 fetchAddr;
+
+    /// Whether to output pixels to the video buffer and GUI
+    bool output = true;
+    void set_output(bool enabled) { output = enabled; }
+
     inline bool rendering() { return mask.bg || mask.spr; }
     inline int spr_height() { return ctrl.sprSz ? 16 : 8; }
 
     /// the GUI this PPU has access to
     GUI* gui;
-    void set_gui(GUI* new_gui) { gui = new_gui; }
+    void set_gui(GUI* new_gui) { gui = new_gui; pixels = gui->video_buffer(); }
     GUI* get_gui() { return gui; }
 
     /// the cartridge this PPU uses for game data
@@ -64,6 +100,8 @@ namespace PPU {
     }
     /// Set the PPU to the given mirroring mode.
     void set_mirroring(Mirroring mode) { mirroring = mode; }
+    /// Return the mirroring mode of the PPU.
+    Mirroring get_mirroring() { return mirroring; }
 
     /// Read an address from PPU memory.
     u8 rd(u16 addr) {
@@ -84,6 +122,60 @@ namespace PPU {
 
         return 0;
     }
+    /// Return an NES color in the pixel format.
+    u32 resolve_color(u8 color) {
+        u32 rgb = nesRgb[color];
+        switch (pixelFormat) {
+            case PIXEL_GRAY: {
+                // ITU-R 601 luma
+                u32 luma = (((rgb >> 16) & 0xFF) * 299 +
+                            ((rgb >>  8) & 0xFF) * 587 +
+                            ( rgb        & 0xFF) * 114) / 1000;
+                return luma * 0x010101;
+            }
+            case PIXEL_INDEX: return color * 0x010101;
+            default:          return rgb;
+        }
+    }
+    /// Resolve the output color of a palette entry.
+    void resolve_palette(int index) {
+        resolvedPalette[index] = resolve_color(rd(0x3F00 + index));
+    }
+    /// Resolve the output colors of all the palette entries.
+    void resolve_palette() {
+        for (int i = 0; i < 0x20; i++)
+            resolve_palette(i);
+    }
+    void set_pixel_format(PixelFormat format) {
+        pixelFormat = format;
+        resolve_palette();
+    }
+
+    void observe(SymbolicObservation* observation) {
+        // the nametable coordinates of the top-left tile (in a 64x60 grid
+        // of the four nametables)
+        int left = (tAddr.nt & 1) * 32 + tAddr.cX;
+        int top = (tAddr.nt >> 1) * 30 + tAddr.cY % 30;
+        for (int row = 0; row < 30; row++) {
+            int y = (top + row) % 60;
+            for (int col = 0; col < 32; col++) {
+                int x = (left + col) % 64;
+                u16 table = 0x2000 + ((y / 30) * 2 + x / 32) * 0x400;
+                int tileX = x % 32, tileY = y % 30;
+                observation->tiles[row][col] = ciRam[nt_mirror(table + tileY * 32 + tileX)];
+                u8 attribute = ciRam[nt_mirror(table + 0x3C0 + (tileY / 4) * 8 + tileX / 4)];
+                int shift = ((tileY & 2) << 1) | (tileX & 2);
+                observation->palettes[row][col] = (attribute >> shift) & 3;
+            }
+        }
+        memcpy(observation->sprites, oamMem, sizeof(oamMem));
+        observation->fineX = fX;
+        observation->fineY = tAddr.fY;
+        observation->bgTable = ctrl.bgTbl;
+        observation->sprTable = ctrl.sprTbl;
+        observation->sprHeight = spr_height();
+    }
+
     /// Write a byte to PPU memory.
     void wr(u16 addr, u8 v) {
         // CHR-ROM/RAM
@@ -99,28 +191,62 @@ namespace PPU {
             if ((addr & 0x13) == 0x10)
                 addr &= ~0x10;
             cgRam[addr & 0x1F] = v;
+            resolve_palette(addr & 0x1F);
+            // The backdrop colors are mirrored by the sprite palettes:
+            if ((addr & 0x03) == 0) resolve_palette((addr & 0x1F) | 0x10);
+        }
+    }
+
+    /* Add or remove a sprite from the rows of the scanlines it covers */
+    void mark_sprite(int i, bool visible) {
+        u64 bit = 1ull << i;
+        int end = std::min(indexedY[i] + indexedHeight, 240);
+        for (int row = indexedY[i]; row < end; row++)
+            spriteRows[row] = visible ? (spriteRows[row] | bit) : (spriteRows[row] & ~bit);
+    }
+    /* Move a sprite to the rows of its current Y coordinate */
+    void index_sprite(int i) {
+        mark_sprite(i, false);
+        indexedY[i] = oamMem[i*4 + 0];
+        mark_sprite(i, true);
+    }
+    /* Rebuild the rows of all the sprites */
+    void index_sprites() {
+        memset(spriteRows, 0, sizeof(spriteRows));
+        indexedHeight = spr_height();
+        for (int i = 0; i < 64; i++) {
+            indexedY[i] = oamMem[i*4 + 0];
+            mark_sprite(i, true);
         }
     }
 
     /// Access PPU through registers.
     template <bool write> u8 access(u16 index, u8 v) {
-        static u8 res;      // Result of the operation.
-        static u8 buffer;   // VRAM read buffer.
-        static bool latch;  // Detect second reading.
-
         /* Write into register */
         if (write) {
             res = v;
 
             switch (index) {
                 // PPUCTRL   ($2000).
-                case 0:  ctrl.r = v; tAddr.nt = ctrl.nt; break;
+                case 0:
+                    ctrl.r = v; tAddr.nt = ctrl.nt;
+                    // Sprites cover more or fewer lines:
+                    if (spr_height() != indexedHeight) index_sprites();
+                    break;
                 // PPUMASK   ($2001).
-                case 1:  mask.r = v; break;
+                case 1:
+                    // Grayscale changes every output color:
+                    if ((mask.r ^ v) & 1) { mask.r = v; resolve_palette(); }
+                    else mask.r = v;
+                    break;
                 // OAMADDR   ($2003).
                 case 3:  oamAddr = v; break;
                 // OAMDATA   ($2004).
-                case 4:  oamMem[oamAddr++] = v; break;
+                case 4:
+                    oamMem[oamAddr] = v;
+                    // The Y coordinate of a sprite moved:
+                    if (oamAddr % 4 == 0) index_sprite(oamAddr / 4);
+                    oamAddr++; break;
                 // PPUSCROLL ($2005).
                 case 5:
                     // First write.
@@ -219,23 +345,23 @@ namespace PPU {
 
     /* Fill secondary OAM with the sprite infos for the next scanline */
     void eval_sprites() {
+        // No sprites are in range on the pre-render line:
+        if (scanline >= 240) return;
         int n = 0;
-        for (int i = 0; i < 64; i++) {
-            int line = (scanline == 261 ? -1 : scanline) - oamMem[i*4 + 0];
-            // If the sprite is in the scanline, copy its properties
-            // into secondary OAM:
-            if (line >= 0 && line < spr_height()) {
-                secOam[n].id   = i;
-                secOam[n].y    = oamMem[i*4 + 0];
-                secOam[n].tile = oamMem[i*4 + 1];
-                secOam[n].attr = oamMem[i*4 + 2];
-                secOam[n].x    = oamMem[i*4 + 3];
-
-                if (++n > 8) {
-                    status.sprOvf = true;
-                    break;
-                }
+        // Copy the properties of the sprites in the scanline (in OAM
+        // order) into secondary OAM:
+        for (u64 sprites = spriteRows[scanline]; sprites; sprites &= sprites - 1) {
+            if (n == 8) {
+                status.sprOvf = true;
+                break;
             }
+            int i = lowest_bit(sprites);
+            secOam[n].id   = i;
+            secOam[n].y    = oamMem[i*4 + 0];
+            secOam[n].tile = oamMem[i*4 + 1];
+            secOam[n].attr = oamMem[i*4 + 2];
+            secOam[n].x    = oamMem[i*4 + 3];
+            n++;
         }
     }
 
@@ -261,7 +387,31 @@ namespace PPU {
 
             oam[i].dataL = rd(addr + 0);
             oam[i].dataH = rd(addr + 8);
+            spritePixels[i] = cartridge->chr_pixels(addr, oam[i].attr & 0x40);
+        }
+        // Composite the new sprites when the line draws them:
+        spriteLineDirty = true;
+    }
+
+    /* Composite the sprites in primary OAM into the sprite line */
+    void build_sprite_line() {
+        memset(spriteLine, 0, sizeof(spriteLine));
+        // Lower OAM slots are drawn over higher ones:
+        for (int i = 7; i >= 0; i--) {
+            // Void entry.
+            if (oam[i].id == 64) continue;
+            u8 flags = ((oam[i].attr & 3) << 2) | 16 | (oam[i].attr & 0x20 ? SPRITE_BEHIND : 0);
+            // The pixels are decoded and flipped already.
+            u64 pixels = spritePixels[i];
+            for (int sprX = 0; pixels && oam[i].x + sprX < 256; sprX++, pixels >>= 8) {
+                u8 sprPalette = pixels & 3;
+                // Transparent pixel.
+                if (sprPalette == 0) continue;
+                u8& pixel = spriteLine[oam[i].x + sprX];
+                pixel = sprPalette | flags | (pixel & SPRITE_ZERO) | (oam[i].id == 0 ? SPRITE_ZERO : 0);
+            }
         }
+        spriteLineDirty = false;
     }
 
     /* Process a pixel, draw it if it's on screen */
@@ -270,7 +420,11 @@ namespace PPU {
         bool objPriority = 0;
         int x = dot - 2;
 
+        // Without output, pixels only matter for sprite 0 hits:
         if (scanline < 240 && x >= 0 && x < 256) {
+            if (output) COUNT(dots_rendered); else COUNT(dots_skipped);
+        }
+        if (scanline < 240 && x >= 0 && x < 256 && (output || oam[0].id == 0)) {
             if (mask.bg && !(!mask.bgLeft && x < 8)) {
                 // Background:
                 palette = (NTH_BIT(bgShiftH, 15 - fX) << 1) |
@@ -280,32 +434,22 @@ namespace PPU {
                                  NTH_BIT(atShiftL,  7 - fX))      << 2;
             }
             // Sprites:
-            if (mask.spr && !(!mask.sprLeft && x < 8))
-                for (int i = 7; i >= 0; i--) {
-                    // Void entry.
-                    if (oam[i].id == 64) continue;
-                    unsigned sprX = x - oam[i].x;
-                    // Not in range.
-                    if (sprX >= 8) continue;
-                    // Horizontal flip.
-                    if (oam[i].attr & 0x40) sprX ^= 7;
-
-                    u8 sprPalette = (NTH_BIT(oam[i].dataH, 7 - sprX) << 1) |
-                                     NTH_BIT(oam[i].dataL, 7 - sprX);
-                    // Transparent pixel.
-                    if (sprPalette == 0) continue;
-
-                    if (oam[i].id == 0 && palette && x != 255)
+            if (mask.spr && !(!mask.sprLeft && x < 8)) {
+                if (spriteLineDirty) build_sprite_line();
+                u8 sprite = spriteLine[x];
+                if (sprite) {
+                    if ((sprite & SPRITE_ZERO) && palette && x != 255)
                         status.sprHit = true;
-                    sprPalette |= (oam[i].attr & 3) << 2;
-                    objPalette  = sprPalette + 16;
-                    objPriority = oam[i].attr & 0x20;
+                    objPalette  = sprite & 0x1F;
+                    objPriority = sprite & SPRITE_BEHIND;
                 }
+            }
             // Evaluate priority:
             if (objPalette && (palette == 0 || objPriority == 0))
                 palette = objPalette;
 
-            pixels[scanline*256 + x] = nesRgb[rd(0x3F00 + (rendering() ? palette : 0))];
+            if (output)
+                pixels[scanline*256 + x] = resolvedPalette[rendering() ? palette : 0];
         }
         // Perform background shifts:
         bgShiftL <<= 1; bgShiftH <<= 1;
@@ -315,10 +459,10 @@ namespace PPU {
 
     /* Execute a cycle of a scanline */
     template<Scanline s> void scanline_cycle() {
-        static u16 addr;
+        u16& addr = fetchAddr;
 
         if (s == NMI && dot == 1) { status.vBlank = true; if (ctrl.nmi) CPU::set_nmi(); }
-        else if (s == POST && dot == 0) gui->new_frame(pixels);
+        else if (s == POST && dot == 0) { if (output) gui->new_frame(pixels); }
         else if (s == VISIBLE || s == PRE) {
             // Sprites:
             switch (dot) {
@@ -410,20 +554,27 @@ namespace PPU {
         scanline = dot = 0;
         ctrl.r = mask.r = status.r = 0;
 
-        memset(pixels, 0x00, sizeof(pixels));
+        memset(pixels, 0x00, 256 * 240 * sizeof(u32));
         memset(ciRam,  0xFF, sizeof(ciRam));
         memset(oamMem, 0x00, sizeof(oamMem));
+        index_sprites();
+        resolve_palette();
     }
 
     PPUState* get_state() {
         PPUState* state = new PPUState();
+        get_state(state);
+        return state;
+    }
+
+    void get_state(PPUState* state) {
+        COUNT_N(snapshot_bytes, sizeof(PPUState));
         state->mirroring = mirroring;
         std::copy(std::begin(ciRam), std::end(ciRam), std::begin(state->ciRam));
         std::copy(std::begin(cgRam), std::end(cgRam), std::begin(state->cgRam));
         std::copy(std::begin(oamMem), std::end(oamMem), std::begin(state->oamMem));
         std::copy(std::begin(oam), std::end(oam), std::begin(state->oam));
         std::copy(std::begin(secOam), std::end(secOam), std::begin(state->secOam));
-        std::copy(std::begin(pixels), std::end(pixels), std::begin(state->pixels));
         state->vAddr = vAddr;
         state->tAddr = tAddr;
         state->fX = fX;
@@ -444,18 +595,20 @@ namespace PPU {
         state->scanline = scanline;
         state->dot = dot;
         state->frameOdd = frameOdd;
-
-        return state;
+        state->res = res;
+        state->buffer = buffer;
+        state->latch = latch;
+        state->fetchAddr = fetchAddr;
     }
 
     void set_state(PPUState* state) {
+        COUNT_N(snapshot_bytes, sizeof(PPUState));
         mirroring = state->mirroring;
         std::copy(std::begin(state->ciRam), std::end(state->ciRam), std::begin(ciRam));
         std::copy(std::begin(state->cgRam), std::end(state->cgRam), std::begin(cgRam));
         std::copy(std::begin(state->oamMem), std::end(state->oamMem), std::begin(oamMem));
         std::copy(std::begin(state->oam), std::end(state->oam), std::begin(oam));
         std::copy(std::begin(state->secOam), std::end(state->secOam), std::begin(secOam));
-        std::copy(std::begin(state->pixels), std::end(state->pixels), std::begin(pixels));
         vAddr = state->vAddr;
         tAddr = state->tAddr;
         fX = state->fX;
@@ -476,5 +629,15 @@ namespace PPU {
         scanline = state->scanline;
         dot = state->dot;
         frameOdd = state->frameOdd;
+        res = state->res;
+        buffer = state->buffer;
+        latch = state->latch;
+        fetchAddr = state->fetchAddr;
+        // the scanline rows, sprite line, and resolved palette aren't part of the state
+        index_sprites();
+        resolve_palette();
+        for (int i = 0; i < 8; i++)
+            spritePixels[i] = ChrCache::decode_row(oam[i].dataL, oam[i].dataH, oam[i].attr & 0x40);
+        spriteLineDirty = true;
     }
 }
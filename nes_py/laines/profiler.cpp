@@ -0,0 +1,60 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include "profiler.hpp"
+
+/// the size of a PRG-ROM bank in the dump (the finest mapping granularity)
+static const u32 BANK_SIZE = 0x2000;
+/// the size of the iNES header before PRG-ROM in the file
+static const u32 HEADER_SIZE = 16;
+
+Profiler::Profiler(u32 prg_size, u32 interval) :
+    interval(interval > 0 ? interval : 1),
+    countdown(interval > 0 ? interval : 1),
+    samples(0),
+    prg_hits(prg_size, 0),
+    prg_addresses(prg_size, 0),
+    low_hits(0x8000, 0) {
+    memset(opcodes, 0, sizeof(opcodes));
+}
+
+/// Return the indexes of the non-zero counts sorted by decreasing count.
+static std::vector<u32> hottest(const u64* counts, u32 size) {
+    std::vector<u32> indexes;
+    for (u32 i = 0; i < size; i++)
+        if (counts[i])
+            indexes.push_back(i);
+    std::stable_sort(indexes.begin(), indexes.end(), [counts](u32 a, u32 b) {
+        return counts[a] > counts[b];
+    });
+    return indexes;
+}
+
+bool Profiler::dump(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (file == nullptr)
+        return false;
+    double total = samples ? samples : 1;
+    fprintf(file, "# samples: %llu (1 in %u instructions)\n",
+        (unsigned long long) samples, interval);
+
+    fprintf(file, "\n# opcodes\n# opcode count percent\n");
+    for (u32 op : hottest(opcodes, 256))
+        fprintf(file, "%02X %llu %.3f\n",
+            op, (unsigned long long) opcodes[op], 100 * opcodes[op] / total);
+
+    fprintf(file, "\n# PRG-ROM (bank of %u bytes, CPU address, iNES file offset)\n", BANK_SIZE);
+    fprintf(file, "# bank address offset count percent\n");
+    for (u32 offset : hottest(prg_hits.data(), prg_hits.size()))
+        fprintf(file, "%02X $%04X 0x%06X %llu %.3f\n",
+            offset / BANK_SIZE, prg_addresses[offset], offset + HEADER_SIZE,
+            (unsigned long long) prg_hits[offset], 100 * prg_hits[offset] / total);
+
+    fprintf(file, "\n# RAM and PRG-RAM\n# address count percent\n");
+    for (u32 address : hottest(low_hits.data(), low_hits.size()))
+        fprintf(file, "$%04X %llu %.3f\n",
+            address, (unsigned long long) low_hits[address], 100 * low_hits[address] / total);
+
+    return fclose(file) == 0;
+}
@@ -1,7 +1,9 @@
 /// File: python_api.py
 /// Description: The API definition for ctypes in Python.
 ///
+#include "actor.hpp"
 #include "nes_env.hpp"
+#include "sequence.hpp"
 
 // Windows-base systems
 #if defined(_WIN32) || defined(WIN32) || defined(__CYGWIN__) || defined(__MINGW32__) || defined(__BORLANDC__)
@@ -22,6 +24,16 @@ extern "C" {
         return new NESEnv(path);
     }
 
+    /// The initializer to return a new NESEnv as a clone of another.
+    exp NESEnv* NESEnv_clone(NESEnv* env) {
+        return new NESEnv(env);
+    }
+
+    /// The function to copy the machine state of an environment into others
+    exp bool NESEnv_broadcast(NESEnv* env, NESEnv** targets, int count) {
+        return env->broadcast(targets, count);
+    }
+
     /// The width of the NES screen.
     exp unsigned NESEnv_width() {
         return GUI::get_width();
@@ -34,22 +46,42 @@ extern "C" {
 
     /// The getter for RAM access
     exp u8 NESEnv_read_mem(NESEnv* env, u16 address) {
-        return CPU::read_mem(address);
+        return env->read_mem(address);
     }
 
     /// The setter for RAM access
     exp void NESEnv_write_mem(NESEnv* env, u16 address, u8 value) {
-        CPU::write_mem(address, value);
+        env->write_mem(address, value);
     }
 
     /// Copy the screen of the emulator to an output buffer (NumPy array)
     exp void NESEnv_screen(NESEnv* env, unsigned char *output_buffer) {
-        PPU::get_gui()->copy_screen(output_buffer);
+        env->screen(output_buffer);
     }
 
     /// The function to reset the environment.
-    exp void NESEnv_reset(NESEnv* env) {
-        env->reset();
+    exp bool NESEnv_reset(NESEnv* env) {
+        return env->reset();
+    }
+
+    /// The function to set the current state as the golden reset state of the ROM
+    exp void NESEnv_set_reset_state(NESEnv* env) {
+        env->set_reset_state();
+    }
+
+    /// The function to set a save-state file as the golden reset state of the ROM
+    exp bool NESEnv_set_reset_state_file(NESEnv* env, StateFile* file) {
+        return env->set_reset_state_file(file);
+    }
+
+    /// The function to remove the golden reset state of the ROM
+    exp void NESEnv_clear_reset_state(NESEnv* env) {
+        env->clear_reset_state();
+    }
+
+    /// The function to return whether the ROM has a golden reset state
+    exp bool NESEnv_has_reset_state(NESEnv* env) {
+        return env->has_reset_state();
     }
 
     /// The function to perform a step on the emulator.
@@ -57,6 +89,32 @@ extern "C" {
         env->step(action);
     }
 
+    /// The function to start a step on the emulator in the background.
+    exp void NESEnv_step_async(NESEnv* env, unsigned char action, int frames, unsigned char *output_buffer,
+        double* reward, u8* done, double* infos) {
+        env->step_async(action, frames, output_buffer, reward, done, infos);
+    }
+
+    /// The function to set the native reward, done, and info of background steps
+    exp void NESEnv_set_step_spec(
+        NESEnv* env,
+        const RewardTerm* reward_terms,
+        int reward_count,
+        const RamCondition* done,
+        int done_count,
+        const RewardTerm* info_terms,
+        const int* info_sizes,
+        int info_count
+    ) {
+        env->set_step_spec(new BatchSpec(reward_terms, reward_count, done, done_count,
+            info_terms, info_sizes, info_count));
+    }
+
+    /// The function to wait for a background step to finish.
+    exp void NESEnv_step_wait(NESEnv* env) {
+        env->step_wait();
+    }
+
     /// The function to destroy an NESEnv and clear it from memory.
     exp void NESEnv_close(NESEnv* env) {
         delete env;
@@ -72,4 +130,349 @@ extern "C" {
         env->restore();
     }
 
+    /// The function to enable or disable rendering frames to the screen
+    exp void NESEnv_set_render(NESEnv* env, bool enabled) {
+        env->set_render(enabled);
+    }
+
+    /// The function to set the format of the pixels in rendered frames
+    exp void NESEnv_set_pixel_format(NESEnv* env, int format) {
+        env->set_pixel_format(static_cast<PixelFormat>(format));
+    }
+
+    /// The function to read a symbolic observation of the screen
+    exp void NESEnv_observe(NESEnv* env, SymbolicObservation* observation) {
+        env->observe(observation);
+    }
+
+    /// The function to step until a predicate on the RAM holds
+    exp unsigned NESEnv_run_until(
+        NESEnv* env,
+        unsigned char action,
+        const RamCondition* conditions,
+        int count,
+        unsigned max_frames,
+        bool per_instruction,
+        int* clause
+    ) {
+        return env->run_until(action, conditions, count, max_frames, per_instruction, clause);
+    }
+
+    /// The function to watch or stop watching writes to an address
+    exp bool NESEnv_watch(NESEnv* env, u16 address, bool enabled) {
+        return env->watch(address, enabled);
+    }
+
+    /// The largest number of watched writes buffered between drains
+    exp unsigned NESEnv_max_watch_events() {
+        return Watchpoints::MAX_EVENTS;
+    }
+
+    /// The function to drain the writes to watched addresses
+    exp unsigned NESEnv_watch_events(NESEnv* env, WatchEvent* output, unsigned* dropped) {
+        return env->watch_events(output, dropped);
+    }
+
+    /// The function to return the hash of the ROM of an environment
+    exp u64 NESEnv_rom_hash(NESEnv* env) {
+        return env->rom_hash();
+    }
+
+    /// The function to write the machine state to a save-state file
+    exp bool NESEnv_save_state_file(NESEnv* env, const char* path) {
+        return env->save_state_file(path);
+    }
+
+    /// The function to load the machine state from an open save-state file
+    exp bool NESEnv_load_state_file(NESEnv* env, StateFile* file) {
+        return env->load_state_file(file);
+    }
+
+    /// The function to open a save-state file (nullptr if invalid)
+    exp StateFile* StateFile_open(const char* path) {
+        return StateFile::open(path);
+    }
+
+    /// The function to return the hash of the ROM of a save-state file
+    exp u64 StateFile_rom_hash(StateFile* file) {
+        return file->rom_hash();
+    }
+
+    /// The function to close a save-state file
+    exp void StateFile_close(StateFile* file) {
+        delete file;
+    }
+
+    /// The function to open or create a state archive (nullptr if invalid)
+    exp StateArchive* StateArchive_open(const char* path, u64 rom_hash) {
+        return StateArchive::open(path, rom_hash);
+    }
+
+    /// The function to return the number of keys in a state archive
+    exp unsigned StateArchive_size(StateArchive* archive) {
+        return archive->size();
+    }
+
+    /// The function to copy the keys of a state archive (in the order added)
+    exp void StateArchive_keys(StateArchive* archive, u64* output) {
+        const std::vector<u64>& keys = archive->get_keys();
+        std::copy(keys.begin(), keys.end(), output);
+    }
+
+    /// The function to return whether a state archive has a key
+    exp bool StateArchive_contains(StateArchive* archive, u64 key) {
+        return archive->contains(key);
+    }
+
+    /// The function to copy the metadata of a key (-1 if missing)
+    exp s64 StateArchive_metadata(StateArchive* archive, u64 key, u8* output, unsigned capacity) {
+        return archive->metadata(key, output, capacity);
+    }
+
+    /// The function to append the states of environments to an archive
+    exp void StateArchive_add(
+        StateArchive* archive,
+        NESEnv** envs,
+        u64* keys,
+        int count,
+        bool hash_keys,
+        const u8* metadata,
+        unsigned metadata_size,
+        bool replace,
+        bool* added
+    ) {
+        for (int i = 0; i < count; i++) {
+            const u8* record_metadata = metadata + static_cast<size_t>(i) * metadata_size;
+            added[i] = envs[i]->archive_state(archive, &keys[i], hash_keys,
+                record_metadata, metadata_size, replace);
+        }
+    }
+
+    /// The function to load the states of keys into environments
+    exp void StateArchive_restore(
+        StateArchive* archive,
+        NESEnv** envs,
+        const u64* keys,
+        int count,
+        bool* restored
+    ) {
+        for (int i = 0; i < count; i++)
+            restored[i] = envs[i]->restore_archived(archive, keys[i]);
+    }
+
+    /// The function to close a state archive
+    exp void StateArchive_close(StateArchive* archive) {
+        delete archive;
+    }
+
+    /// The function to step a batch of environments with auto-reset
+    exp void NESEnv_step_batch(
+        NESEnv** envs,
+        int count,
+        const u8* actions,
+        int frames,
+        const RewardTerm* reward_terms,
+        int reward_count,
+        const RamCondition* done,
+        int done_count,
+        const RewardTerm* info_terms,
+        const int* info_sizes,
+        int info_count,
+        double* rewards,
+        u8* dones,
+        double* infos,
+        u8* screens,
+        u8* terminal_screens,
+        u8* ram
+    ) {
+        BatchSpec spec(reward_terms, reward_count, done, done_count,
+            info_terms, info_sizes, info_count);
+        NESEnv::step_batch(envs, count, actions, frames, spec,
+            rewards, dones, infos, screens, terminal_screens, ram);
+    }
+
+    /// The function to copy the RAM of a batch of environments into rows
+    exp void NESEnv_read_ram_batch(NESEnv** envs, int count, u8* ram, u8* prg_ram) {
+        NESEnv::read_ram_batch(envs, count, ram, prg_ram);
+    }
+
+    /// The function to run open-loop rollouts from the current state
+    exp void NESEnv_rollout(
+        NESEnv* env,
+        const u8* actions,
+        int rollouts,
+        int length,
+        const RewardTerm* terms,
+        int term_count,
+        const RamCondition* done,
+        int done_count,
+        int workers,
+        double* rewards,
+        u32* frames,
+        u8* final_ram
+    ) {
+        env->rollout(actions, rollouts, length, terms, term_count,
+            done, done_count, workers, rewards, frames, final_ram);
+    }
+
+    /// The function to start recording inputs to an input log
+    exp void NESEnv_record(NESEnv* env, unsigned keyframe_interval) {
+        env->record(keyframe_interval);
+    }
+
+    /// The function to stop recording and write the input log to a file
+    exp bool NESEnv_stop_recording(NESEnv* env, const char* path) {
+        return env->stop_recording(path);
+    }
+
+    /// The function to seek to a frame of an input log
+    exp bool NESEnv_seek(NESEnv* env, InputLog* log, unsigned frame) {
+        return env->seek(log, frame);
+    }
+
+    /// The function to start profiling the guest code
+    exp void NESEnv_profile(NESEnv* env, unsigned interval) {
+        env->profile(interval);
+    }
+
+    /// The function to stop profiling and write the profile to a file
+    exp bool NESEnv_stop_profile(NESEnv* env, const char* path) {
+        return env->stop_profile(path);
+    }
+
+    /// The function to summarize the latencies of an operation
+    exp void NESEnv_latency(NESEnv* env, int op, const double* percents, int count, double* output) {
+        env->latency(static_cast<LatencyOp>(op), percents, count, output);
+    }
+
+    /// The function to remove the recorded latencies of an environment
+    exp void NESEnv_reset_latency(NESEnv* env) {
+        env->reset_latency();
+    }
+
+    /// The function to start recording a timeline of all environments
+    exp void Trace_start() {
+        Trace::start();
+    }
+
+    /// The function to stop recording the timeline and write it to a file
+    exp bool Trace_stop(const char* path) {
+        return Trace::stop(path);
+    }
+
+    /// Return true if the hardware counters are compiled in
+    exp bool NESEnv_counters_enabled() {
+        return COUNTERS_ENABLED;
+    }
+
+    /// The function to copy the hardware counters of an environment
+    exp void NESEnv_counters(NESEnv* env, Counters* output) {
+        env->get_counters(output);
+    }
+
+    /// The function to measure the memory footprint of an environment
+    exp void NESEnv_footprint(NESEnv* env, MemoryFootprint* output) {
+        env->footprint(output);
+    }
+
+    /// The function to reset the hardware counters of an environment
+    exp void NESEnv_reset_counters(NESEnv* env) {
+        env->reset_counters();
+    }
+
+    /// The function to read an input log from a file
+    exp InputLog* InputLog_read(const char* path) {
+        return InputLog::read(path);
+    }
+
+    /// The function to return the number of frames in an input log
+    exp unsigned InputLog_frames(InputLog* log) {
+        return log->get_frames();
+    }
+
+    /// The function to return the hash of the ROM of an input log
+    exp u64 InputLog_rom_hash(InputLog* log) {
+        return log->get_rom_hash();
+    }
+
+    /// The function to destroy an input log and clear it from memory
+    exp void InputLog_close(InputLog* log) {
+        delete log;
+    }
+
+    /// The function to read a counter in shared memory
+    exp u32 Sequence_load(u32* seq) {
+        return Sequence::load(seq);
+    }
+
+    /// The function to publish a counter in shared memory
+    exp void Sequence_store(u32* seq, u32 value) {
+        Sequence::store(seq, value);
+    }
+
+    /// The function to wait for a counter in shared memory (with a timeout)
+    exp bool Sequence_wait(u32* seq, u32 value, int timeout) {
+        return Sequence::wait(seq, value, timeout);
+    }
+
+    /// The function to return the size of the memory for a queue
+    exp size_t SpscQueue_size(u32 capacity, u32 slot_size) {
+        return SpscQueue::size(capacity, slot_size);
+    }
+
+    /// The function to initialize an empty queue in memory
+    exp void SpscQueue_init(void* memory, u32 capacity, u32 slot_size) {
+        SpscQueue::initialize(memory, capacity, slot_size);
+    }
+
+    /// The function to return the number of items in a queue
+    exp u32 SpscQueue_count(void* memory) {
+        return SpscQueue(memory).count();
+    }
+
+    /// The function to wait for a free slot at the back of a queue (with a timeout)
+    exp u32 SpscQueue_back(void* memory, int timeout) {
+        return SpscQueue(memory).back(timeout);
+    }
+
+    /// The function to publish the item at the back of a queue
+    exp void SpscQueue_push(void* memory) {
+        SpscQueue(memory).push();
+    }
+
+    /// The function to wait for the item at the front of a queue (with a timeout)
+    exp u32 SpscQueue_front(void* memory, int timeout) {
+        return SpscQueue(memory).front(timeout);
+    }
+
+    /// The function to free the item at the front of a queue
+    exp void SpscQueue_pop(void* memory) {
+        SpscQueue(memory).pop();
+    }
+
+    /// The function to return the layout of the slots of the queues of an actor
+    exp void Actor_layout(int count, int info_count, ActorLayout* output) {
+        *output = Actor::layout(count, info_count);
+    }
+
+    /// The function to serve commands to an actor until a close command
+    exp void Actor_serve(
+        NESEnv** envs,
+        int count,
+        int frames,
+        const RewardTerm* reward_terms,
+        int reward_count,
+        const RamCondition* done,
+        int done_count,
+        const RewardTerm* info_terms,
+        const int* info_sizes,
+        int info_count,
+        void* action_queue,
+        void* observation_queue
+    ) {
+        BatchSpec spec(reward_terms, reward_count, done, done_count,
+            info_terms, info_sizes, info_count);
+        Actor::serve(envs, count, frames, spec, action_queue, observation_queue);
+    }
+
 }
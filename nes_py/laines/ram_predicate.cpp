@@ -0,0 +1,8 @@
+#include <algorithm>
+#include "ram_predicate.hpp"
+
+RamPredicate::RamPredicate(const RamCondition* conditions, int count) :
+    conditions(conditions, conditions + count), baseline(count, 0) {
+    std::stable_sort(this->conditions.begin(), this->conditions.end(),
+        [](const RamCondition& a, const RamCondition& b) { return a.clause < b.clause; });
+}
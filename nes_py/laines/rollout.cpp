@@ -0,0 +1,62 @@
+#include <algorithm>
+#include <cerrno>
+#include "rollout.hpp"
+
+#if defined(_WIN32)
+
+bool run_forked(int jobs, int workers,
+    const std::function<void(int, RolloutResult*)>& job, RolloutResult* results) {
+    return false;
+}
+
+#else
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+bool run_forked(int jobs, int workers,
+    const std::function<void(int, RolloutResult*)>& job, RolloutResult* results) {
+    size_t size = jobs * sizeof(RolloutResult);
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+        return false;
+    RolloutResult* shared = static_cast<RolloutResult*>(memory);
+    workers = std::max(1, std::min(workers, jobs));
+    std::vector<pid_t> children;
+    std::vector<int> unforked;
+    for (int worker = 0; worker < workers; worker++) {
+        pid_t pid = fork();
+        // run the jobs of the worker and exit without any cleanup
+        if (pid == 0) {
+            for (int k = worker; k < jobs; k += workers)
+                job(k, &shared[k]);
+            _exit(0);
+        }
+        if (pid > 0)
+            children.push_back(pid);
+        else
+            unforked.push_back(worker);
+    }
+    bool succeeded = !children.empty();
+    // run the jobs of workers that couldn't be forked in this process
+    if (succeeded) {
+        for (int worker : unforked)
+            for (int k = worker; k < jobs; k += workers)
+                job(k, &shared[k]);
+    }
+    for (pid_t pid : children) {
+        int status = 0;
+        pid_t waited;
+        do {
+            waited = waitpid(pid, &status, 0);
+        } while (waited < 0 && errno == EINTR);
+        succeeded = succeeded && waited == pid &&
+            WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+    if (succeeded)
+        std::copy(shared, shared + jobs, results);
+    munmap(memory, size);
+    return succeeded;
+}
+
+#endif
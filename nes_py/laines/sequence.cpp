@@ -0,0 +1,77 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "sequence.hpp"
+
+#if defined(__linux__)
+    #include <linux/futex.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+namespace Sequence {
+    /// the number of times to poll a counter before blocking on it
+    const int SPIN_COUNT = 4096;
+
+    /// Return the counter as an atomic integer.
+    inline std::atomic<u32>* atomic(u32* seq) {
+        return reinterpret_cast<std::atomic<u32>*>(seq);
+    }
+
+    /// Return the number of processes blocked on a counter.
+    inline std::atomic<u32>* waiters(u32* seq) {
+        return reinterpret_cast<std::atomic<u32>*>(seq + 1);
+    }
+
+    /// Return true if the counter has reached the given value.
+    inline bool reached(u32 current, u32 value) {
+        return static_cast<s32>(current - value) >= 0;
+    }
+
+    u32 load(u32* seq) {
+        return atomic(seq)->load(std::memory_order_acquire);
+    }
+
+    void store(u32* seq, u32 value) {
+        // sequentially consistent, so either the store is seen by a waiter
+        // before it blocks or the waiter is seen here
+        atomic(seq)->store(value, std::memory_order_seq_cst);
+#if defined(__linux__)
+        // wake the processes blocked on the counter (shared, not private)
+        if (waiters(seq)->load(std::memory_order_seq_cst) != 0)
+            syscall(SYS_futex, seq, FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+#endif
+    }
+
+    bool wait(u32* seq, u32 value, int timeout) {
+        // poll the counter first, steps are usually short
+        for (int i = 0; i < SPIN_COUNT; i++)
+            if (reached(load(seq), value))
+                return true;
+        // block until the producer publishes a new value or time runs out
+        typedef std::chrono::steady_clock Clock;
+        Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout);
+        waiters(seq)->fetch_add(1, std::memory_order_seq_cst);
+        bool done;
+        u32 current;
+        while (!(done = reached(current = atomic(seq)->load(std::memory_order_seq_cst), value))) {
+            std::chrono::nanoseconds remaining(0);
+            if (timeout >= 0) {
+                remaining = deadline - Clock::now();
+                if (remaining.count() <= 0)
+                    break;
+            }
+#if defined(__linux__)
+            timespec time;
+            time.tv_sec = remaining.count() / 1000000000;
+            time.tv_nsec = remaining.count() % 1000000000;
+            // returns early on wake-ups, signals, and changed counters
+            syscall(SYS_futex, seq, FUTEX_WAIT, current, timeout >= 0 ? &time : nullptr, nullptr, 0);
+#else
+            std::this_thread::yield();
+#endif
+        }
+        waiters(seq)->fetch_sub(1, std::memory_order_relaxed);
+        return done;
+    }
+}
@@ -0,0 +1,46 @@
+#include "spsc_queue.hpp"
+#include "sequence.hpp"
+
+size_t SpscQueue::size(u32 capacity, u32 slot_size) {
+    slot_size = (slot_size + LINE - 1) / LINE * LINE;
+    return sizeof(QueueHeader) + static_cast<size_t>(capacity) * slot_size;
+}
+
+void SpscQueue::initialize(void* memory, u32 capacity, u32 slot_size) {
+    QueueHeader* header = static_cast<QueueHeader*>(memory);
+    header->head = 0;
+    header->head_waiters = 0;
+    header->tail = 0;
+    header->tail_waiters = 0;
+    header->capacity = capacity;
+    header->slot_size = (slot_size + LINE - 1) / LINE * LINE;
+}
+
+u32 SpscQueue::count() {
+    return Sequence::load(&header->head) - Sequence::load(&header->tail);
+}
+
+u32 SpscQueue::back(int timeout) {
+    // only the producer writes the head, so it can be read directly
+    u32 head = header->head;
+    // wait for the consumer to free the slot of the item a lap behind
+    if (!Sequence::wait(&header->tail, head - header->capacity + 1, timeout))
+        return TIMEOUT;
+    return index(head);
+}
+
+void SpscQueue::push() {
+    Sequence::store(&header->head, header->head + 1);
+}
+
+u32 SpscQueue::front(int timeout) {
+    // only the consumer writes the tail, so it can be read directly
+    u32 tail = header->tail;
+    if (!Sequence::wait(&header->head, tail + 1, timeout))
+        return TIMEOUT;
+    return index(tail);
+}
+
+void SpscQueue::pop() {
+    Sequence::store(&header->tail, header->tail + 1);
+}
@@ -0,0 +1,167 @@
+#include <algorithm>
+#include "state_archive.hpp"
+#include "state_stream.hpp"
+
+#if defined(_WIN32)
+    #include <io.h>
+    #define MAP_ARCHIVES false
+    #define truncate_file(file, size) _chsize_s(_fileno(file), size)
+#else
+    #include <sys/mman.h>
+    #include <unistd.h>
+    #define MAP_ARCHIVES true
+    #define truncate_file(file, size) ftruncate(fileno(file), size)
+#endif
+
+/// the magic bytes at the start of an archive file
+static const u8 MAGIC[4] = {'N', 'E', 'S', 'A'};
+/// the version of the archive file format
+static const u32 VERSION = 1;
+
+StateArchive::StateArchive(FILE* file, u64 rom_hash) :
+    file(file), romHash(rom_hash), end(HEADER_SIZE), mapped(nullptr), mappedSize(0) { }
+
+StateArchive* StateArchive::open(const char* path, u64 rom_hash) {
+    FILE* file = fopen(path, "r+b");
+    // create a new archive
+    if (file == nullptr) {
+        file = fopen(path, "w+b");
+        if (file == nullptr)
+            return nullptr;
+        StateWriter stream;
+        stream.write(MAGIC, sizeof(MAGIC));
+        stream.write(VERSION);
+        stream.write(rom_hash);
+        bool written = fwrite(stream.data.data(), 1, HEADER_SIZE, file) == HEADER_SIZE;
+        if (!written || fflush(file) != 0) {
+            fclose(file);
+            return nullptr;
+        }
+        return new StateArchive(file, rom_hash);
+    }
+    // validate the header of an existing archive
+    u8 header[HEADER_SIZE];
+    bool valid = fread(header, 1, HEADER_SIZE, file) == HEADER_SIZE;
+    if (valid) {
+        StateReader stream(header, HEADER_SIZE);
+        u8 magic[4];
+        stream.read(magic, sizeof(magic));
+        valid = std::equal(magic, magic + 4, MAGIC) &&
+            stream.read<u32>() == VERSION &&
+            stream.read<u64>() == rom_hash;
+    }
+    if (!valid) {
+        fclose(file);
+        return nullptr;
+    }
+    StateArchive* archive = new StateArchive(file, rom_hash);
+    if (!archive->scan()) {
+        delete archive;
+        return nullptr;
+    }
+    return archive;
+}
+
+StateArchive::~StateArchive() {
+#if MAP_ARCHIVES
+    if (mapped != nullptr)
+        munmap(const_cast<u8*>(mapped), mappedSize);
+#endif
+    fclose(file);
+}
+
+bool StateArchive::scan() {
+    fseek(file, 0, SEEK_END);
+    u64 size = ftell(file);
+    // stop at the first record that doesn't fit in the file
+    end = HEADER_SIZE;
+    while (end + RECORD_HEADER_SIZE <= size) {
+        StateReader stream(view(end, RECORD_HEADER_SIZE), RECORD_HEADER_SIZE);
+        u64 key = stream.read<u64>();
+        u64 length = RECORD_HEADER_SIZE + stream.read<u32>() + stream.read<u32>();
+        if (end + length > size)
+            break;
+        if (index.count(key) == 0)
+            keys.push_back(key);
+        index[key] = end;
+        end += length;
+    }
+    // discard a truncated record so appends follow the last whole one
+    if (end < size && truncate_file(file, end) != 0)
+        return false;
+    return true;
+}
+
+const u8* StateArchive::view(u64 offset, u64 size) {
+#if MAP_ARCHIVES
+    // map the file again once it has grown past the mapping
+    if (offset + size > mappedSize) {
+        if (mapped != nullptr)
+            munmap(const_cast<u8*>(mapped), mappedSize);
+        fseek(file, 0, SEEK_END);
+        mappedSize = ftell(file);
+        void* bytes = mmap(nullptr, mappedSize, PROT_READ, MAP_SHARED, fileno(file), 0);
+        mapped = bytes != MAP_FAILED ? static_cast<const u8*>(bytes) : nullptr;
+        if (mapped == nullptr)
+            mappedSize = 0;
+    }
+    if (mapped != nullptr && offset + size <= mappedSize)
+        return mapped + offset;
+#endif
+    // read the bytes when the file can't be mapped
+    scratch.resize(size);
+    fseek(file, offset, SEEK_SET);
+    if (fread(scratch.data(), 1, size, file) != size)
+        std::fill(scratch.begin(), scratch.end(), 0);
+    return scratch.data();
+}
+
+bool StateArchive::append(u64 key, const std::vector<u8>& state,
+    const u8* metadata, u32 metadata_size, bool replace) {
+    bool exists = index.count(key) > 0;
+    if (exists && !replace)
+        return false;
+    StateWriter stream;
+    stream.write(key);
+    stream.write(metadata_size);
+    stream.write<u32>(state.size());
+    stream.write(metadata, metadata_size);
+    stream.write(state.data(), state.size());
+    fseek(file, end, SEEK_SET);
+    bool written = fwrite(stream.data.data(), 1, stream.data.size(), file) == stream.data.size();
+    if (fflush(file) != 0 || !written) {
+        // drop a partial record so the archive stays valid
+        truncate_file(file, end);
+        return false;
+    }
+    if (!exists)
+        keys.push_back(key);
+    index[key] = end;
+    end += stream.data.size();
+    return true;
+}
+
+bool StateArchive::state(u64 key, const u8** state, u32* size) {
+    auto record = index.find(key);
+    if (record == index.end())
+        return false;
+    StateReader stream(view(record->second, RECORD_HEADER_SIZE), RECORD_HEADER_SIZE);
+    stream.read<u64>();
+    u32 metadata_size = stream.read<u32>();
+    *size = stream.read<u32>();
+    u64 offset = record->second + RECORD_HEADER_SIZE + metadata_size;
+    *state = view(offset, *size);
+    return true;
+}
+
+s64 StateArchive::metadata(u64 key, u8* output, u32 capacity) {
+    auto record = index.find(key);
+    if (record == index.end())
+        return -1;
+    StateReader stream(view(record->second, RECORD_HEADER_SIZE), RECORD_HEADER_SIZE);
+    stream.read<u64>();
+    u32 size = stream.read<u32>();
+    if (size <= capacity)
+        std::copy_n(view(record->second + RECORD_HEADER_SIZE, size), size, output);
+    return size;
+}
@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <cstdio>
+#include "state_file.hpp"
+#include "state_stream.hpp"
+
+#if defined(_WIN32)
+    #define MAP_STATE_FILES false
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+    #define MAP_STATE_FILES true
+#endif
+
+/// the magic bytes at the start of a save-state file
+static const u8 MAGIC[4] = {'N', 'E', 'S', 'S'};
+/// the version of the save-state file format
+static const u32 VERSION = 1;
+
+bool StateFile::write(const char* path, u64 rom_hash, const std::vector<u8>& state) {
+    StateWriter stream;
+    // write the header
+    stream.write(MAGIC, sizeof(MAGIC));
+    stream.write(VERSION);
+    stream.write(rom_hash);
+    stream.write<u64>(state.size());
+    // write the file
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr)
+        return false;
+    bool written =
+        fwrite(stream.data.data(), 1, stream.data.size(), file) == stream.data.size() &&
+        fwrite(state.data(), 1, state.size(), file) == state.size();
+    return fclose(file) == 0 && written;
+}
+
+StateFile* StateFile::open(const char* path) {
+    StateFile* file = new StateFile();
+#if MAP_STATE_FILES
+    int descriptor = ::open(path, O_RDONLY);
+    if (descriptor < 0) {
+        delete file;
+        return nullptr;
+    }
+    struct stat status;
+    if (fstat(descriptor, &status) == 0 && status.st_size >= (off_t) HEADER_SIZE) {
+        void* mapped = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, descriptor, 0);
+        if (mapped != MAP_FAILED) {
+            file->data = static_cast<const u8*>(mapped);
+            file->size = status.st_size;
+        }
+    }
+    close(descriptor);
+#else
+    FILE* stream = fopen(path, "rb");
+    if (stream != nullptr) {
+        fseek(stream, 0, SEEK_END);
+        long size = ftell(stream);
+        fseek(stream, 0, SEEK_SET);
+        file->buffer.resize(size > 0 ? size : 0);
+        if (fread(file->buffer.data(), 1, file->buffer.size(), stream) == file->buffer.size()) {
+            file->data = file->buffer.data();
+            file->size = file->buffer.size();
+        }
+        fclose(stream);
+    }
+#endif
+    // validate the header
+    bool valid = file->data != nullptr && file->size >= HEADER_SIZE;
+    if (valid) {
+        StateReader stream(file->data, HEADER_SIZE);
+        u8 magic[4];
+        stream.read(magic, sizeof(magic));
+        valid = std::equal(magic, magic + 4, MAGIC) && stream.read<u32>() == VERSION;
+        // skip the ROM hash (it's checked against the ROM when loading)
+        stream.read<u64>();
+        valid = valid && stream.read<u64>() == file->size - HEADER_SIZE;
+    }
+    if (!valid) {
+        delete file;
+        return nullptr;
+    }
+    return file;
+}
+
+StateFile::~StateFile() {
+#if MAP_STATE_FILES
+    if (data != nullptr)
+        munmap(const_cast<u8*>(data), size);
+#endif
+}
+
+u64 StateFile::rom_hash() {
+    StateReader stream(data + 8, 8);
+    return stream.read<u64>();
+}
@@ -0,0 +1,42 @@
+#include <algorithm>
+#include <cstring>
+#include "watchpoints.hpp"
+
+/// Fold RAM mirrors ($0800-$1FFF) into $0000-$07FF.
+static inline u16 fold(u16 address) {
+    return address < 0x2000 ? address % 0x800 : address;
+}
+
+Watchpoints::Watchpoints() : count(0), dropped(0), frame(0) {
+    memset(pages, 0, sizeof(pages));
+    memset(addresses, 0, sizeof(addresses));
+    events.reserve(MAX_EVENTS);
+}
+
+void Watchpoints::watch(u16 address, bool enabled) {
+    address = fold(address);
+    u64 bit = 1ull << (address & 63);
+    bool watched = addresses[address >> 6] & bit;
+    if (watched == enabled)
+        return;
+    count += enabled ? 1 : -1;
+    addresses[address >> 6] ^= bit;
+    // the page is watched while any of its 4 words of addresses are
+    u16 page = address >> 8;
+    u64* words = &addresses[page * 4];
+    bool any = words[0] | words[1] | words[2] | words[3];
+    if (any)
+        pages[page >> 6] |= 1ull << (page & 63);
+    else
+        pages[page >> 6] &= ~(1ull << (page & 63));
+}
+
+u32 Watchpoints::drain(WatchEvent* output, u32* dropped) {
+    u32 size = events.size();
+    std::copy(events.begin(), events.end(), output);
+    events.clear();
+    *dropped = this->dropped;
+    this->dropped = 0;
+    frame = 0;
+    return size;
+}
@@ -0,0 +1,45 @@
+#include "worker.hpp"
+
+Worker::Worker() : busy(false), stopping(false) {
+    thread = std::thread(&Worker::run, this);
+}
+
+Worker::~Worker() {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [this] { return !busy; });
+        stopping = true;
+    }
+    condition.notify_all();
+    thread.join();
+}
+
+void Worker::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        condition.wait(lock, [this] { return busy || stopping; });
+        if (stopping)
+            return;
+        // run the job without holding the lock so wait() can block on it
+        lock.unlock();
+        job();
+        lock.lock();
+        busy = false;
+        condition.notify_all();
+    }
+}
+
+void Worker::submit(std::function<void()> new_job) {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [this] { return !busy; });
+        job = new_job;
+        busy = true;
+    }
+    condition.notify_all();
+}
+
+void Worker::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [this] { return !busy; });
+}
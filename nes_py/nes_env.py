@@ -1,8 +1,11 @@
 """A CTypes interface to the C++ NES environment."""
 import os
 import sys
+import copy
 import ctypes
 import itertools
+import multiprocessing
+import warnings
 from glob import glob
 import gym
 import numpy as np
@@ -25,6 +28,12 @@ _LIB = ctypes.cdll.LoadLibrary(glob(_LIB_PATH)[0])
 # setup the argument and return types for NESEnv_init
 _LIB.NESEnv_init.argtypes = [ctypes.c_wchar_p]
 _LIB.NESEnv_init.restype = ctypes.c_void_p
+# setup the argument and return types for NESEnv_clone
+_LIB.NESEnv_clone.argtypes = [ctypes.c_void_p]
+_LIB.NESEnv_clone.restype = ctypes.c_void_p
+# setup the argument and return types for NESEnv_broadcast
+_LIB.NESEnv_broadcast.argtypes = [ctypes.c_void_p, ctypes.POINTER(ctypes.c_void_p), ctypes.c_int]
+_LIB.NESEnv_broadcast.restype = ctypes.c_bool
 # setup the argument and return types for NESEnv_width
 _LIB.NESEnv_width.argtypes = None
 _LIB.NESEnv_width.restype = ctypes.c_uint
@@ -42,10 +51,36 @@ _LIB.NESEnv_screen.argtypes = [ctypes.c_void_p, ctypes.c_void_p]
 _LIB.NESEnv_screen.restype = None
 # setup the argument and return types for NESEnv_reset
 _LIB.NESEnv_reset.argtypes = [ctypes.c_void_p]
-_LIB.NESEnv_reset.restype = None
+_LIB.NESEnv_reset.restype = ctypes.c_bool
+# setup the argument and return types for NESEnv_set_reset_state
+_LIB.NESEnv_set_reset_state.argtypes = [ctypes.c_void_p]
+_LIB.NESEnv_set_reset_state.restype = None
+# setup the argument and return types for NESEnv_set_reset_state_file
+_LIB.NESEnv_set_reset_state_file.argtypes = [ctypes.c_void_p, ctypes.c_void_p]
+_LIB.NESEnv_set_reset_state_file.restype = ctypes.c_bool
+# setup the argument and return types for NESEnv_clear_reset_state
+_LIB.NESEnv_clear_reset_state.argtypes = [ctypes.c_void_p]
+_LIB.NESEnv_clear_reset_state.restype = None
+# setup the argument and return types for NESEnv_has_reset_state
+_LIB.NESEnv_has_reset_state.argtypes = [ctypes.c_void_p]
+_LIB.NESEnv_has_reset_state.restype = ctypes.c_bool
 # setup the argument and return types for NESEnv_step
 _LIB.NESEnv_step.argtypes = [ctypes.c_void_p, ctypes.c_ubyte]
 _LIB.NESEnv_step.restype = None
+# setup the argument and return types for NESEnv_step_async
+_LIB.NESEnv_step_async.argtypes = [
+    ctypes.c_void_p,
+    ctypes.c_ubyte,
+    ctypes.c_int,
+    ctypes.c_void_p,
+    ctypes.c_void_p,
+    ctypes.c_void_p,
+    ctypes.c_void_p,
+]
+_LIB.NESEnv_step_async.restype = None
+# setup the argument and return types for NESEnv_step_wait
+_LIB.NESEnv_step_wait.argtypes = [ctypes.c_void_p]
+_LIB.NESEnv_step_wait.restype = None
 # setup the argument and return types for NESEnv_close
 _LIB.NESEnv_close.argtypes = [ctypes.c_void_p]
 _LIB.NESEnv_close.restype = None
@@ -55,6 +90,374 @@ _LIB.NESEnv_backup.restype = None
 # setup the argument and return types for NESEnv_restore
 _LIB.NESEnv_restore.argtypes = [ctypes.c_void_p]
 _LIB.NESEnv_restore.restype = None
+# setup the argument and return types for NESEnv_set_render
+_LIB.NESEnv_set_render.argtypes = [ctypes.c_void_p, ctypes.c_bool]
+_LIB.NESEnv_set_render.restype = None
+# setup the argument and return types for NESEnv_set_pixel_format
+_LIB.NESEnv_set_pixel_format.argtypes = [ctypes.c_void_p, ctypes.c_int]
+_LIB.NESEnv_set_pixel_format.restype = None
+# setup the argument and return types for NESEnv_record
+_LIB.NESEnv_record.argtypes = [ctypes.c_void_p, ctypes.c_uint]
+_LIB.NESEnv_record.restype = None
+# setup the argument and return types for NESEnv_stop_recording
+_LIB.NESEnv_stop_recording.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+_LIB.NESEnv_stop_recording.restype = ctypes.c_bool
+# setup the argument and return types for NESEnv_seek
+_LIB.NESEnv_seek.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_uint]
+_LIB.NESEnv_seek.restype = ctypes.c_bool
+# setup the argument and return types for NESEnv_profile
+_LIB.NESEnv_profile.argtypes = [ctypes.c_void_p, ctypes.c_uint]
+_LIB.NESEnv_profile.restype = None
+# setup the argument and return types for NESEnv_stop_profile
+_LIB.NESEnv_stop_profile.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+_LIB.NESEnv_stop_profile.restype = ctypes.c_bool
+# setup the argument and return types for NESEnv_latency
+_LIB.NESEnv_latency.argtypes = [
+    ctypes.c_void_p,
+    ctypes.c_int,
+    ctypes.POINTER(ctypes.c_double),
+    ctypes.c_int,
+    ctypes.POINTER(ctypes.c_double),
+]
+_LIB.NESEnv_latency.restype = None
+# setup the argument and return types for NESEnv_reset_latency
+_LIB.NESEnv_reset_latency.argtypes = [ctypes.c_void_p]
+_LIB.NESEnv_reset_latency.restype = None
+# setup the argument and return types for Trace_start
+_LIB.Trace_start.argtypes = None
+_LIB.Trace_start.restype = None
+# setup the argument and return types for Trace_stop
+_LIB.Trace_stop.argtypes = [ctypes.c_char_p]
+_LIB.Trace_stop.restype = ctypes.c_bool
+# setup the argument and return types for NESEnv_counters_enabled
+_LIB.NESEnv_counters_enabled.argtypes = None
+_LIB.NESEnv_counters_enabled.restype = ctypes.c_bool
+
+
+class _Counters(ctypes.Structure):
+    """The hardware counters of an environment (Counters in counters.hpp)."""
+    _fields_ = [(name, ctypes.c_uint64) for name in [
+        'instructions',
+        'cycles',
+        'dots_rendered',
+        'dots_skipped',
+        'ram_accesses',
+        'ppu_accesses',
+        'apu_accesses',
+        'joypad_accesses',
+        'cartridge_accesses',
+        'mapper_writes',
+        'mapper_applies',
+        'nmis',
+        'irqs',
+        'snapshot_bytes',
+    ]]
+
+
+# setup the argument and return types for NESEnv_counters
+_LIB.NESEnv_counters.argtypes = [ctypes.c_void_p, ctypes.POINTER(_Counters)]
+_LIB.NESEnv_counters.restype = None
+# setup the argument and return types for NESEnv_reset_counters
+_LIB.NESEnv_reset_counters.argtypes = [ctypes.c_void_p]
+_LIB.NESEnv_reset_counters.restype = None
+
+
+class _MemoryFootprint(ctypes.Structure):
+    """The memory footprint of an environment (MemoryFootprint in nes_env.hpp)."""
+    _fields_ = [(name, ctypes.c_uint64) for name in [
+        'instance',
+        'state',
+        'backup',
+        'framebuffer',
+        'serialized',
+        'shared',
+    ]]
+
+
+# setup the argument and return types for NESEnv_footprint
+_LIB.NESEnv_footprint.argtypes = [ctypes.c_void_p, ctypes.POINTER(_MemoryFootprint)]
+_LIB.NESEnv_footprint.restype = None
+
+
+class _SymbolicObservation(ctypes.Structure):
+    """A symbolic observation of the screen (SymbolicObservation in ppu.hpp)."""
+    _fields_ = [
+        ('tiles', (ctypes.c_uint8 * 32) * 30),
+        ('palettes', (ctypes.c_uint8 * 32) * 30),
+        ('sprites', (ctypes.c_uint8 * 4) * 64),
+        ('fine_x', ctypes.c_uint8),
+        ('fine_y', ctypes.c_uint8),
+        ('bg_table', ctypes.c_uint8),
+        ('sprite_table', ctypes.c_uint8),
+        ('sprite_height', ctypes.c_uint8),
+    ]
+
+
+# setup the argument and return types for NESEnv_observe
+_LIB.NESEnv_observe.argtypes = [ctypes.c_void_p, ctypes.POINTER(_SymbolicObservation)]
+_LIB.NESEnv_observe.restype = None
+
+
+class _RamCondition(ctypes.Structure):
+    """A condition on a byte of RAM (RamCondition in ram_predicate.hpp)."""
+    _fields_ = [
+        ('address', ctypes.c_uint16),
+        ('op', ctypes.c_uint8),
+        ('value', ctypes.c_uint8),
+        ('mask', ctypes.c_uint8),
+        ('clause', ctypes.c_uint16),
+    ]
+
+
+# the comparisons of RAM conditions (in the order of the C++ RamOp)
+RAM_OPS = ['==', '!=', '<', '<=', '>', '>=', 'changed']
+# the number of clauses a RAM predicate can have (RamCondition::clause)
+MAX_CLAUSES = 0x10000
+# setup the argument and return types for NESEnv_run_until
+_LIB.NESEnv_run_until.argtypes = [
+    ctypes.c_void_p,
+    ctypes.c_ubyte,
+    ctypes.POINTER(_RamCondition),
+    ctypes.c_int,
+    ctypes.c_uint,
+    ctypes.c_bool,
+    ctypes.POINTER(ctypes.c_int),
+]
+_LIB.NESEnv_run_until.restype = ctypes.c_uint
+
+
+def _ram_conditions(clauses):
+    """
+    Return the native conditions of a RAM predicate.
+
+    Args:
+        clauses (list): a list of clauses as lists of conditions (see
+            NESEnv._run_until)
+
+    Returns:
+        a ctypes array of _RamCondition
+
+    """
+    if len(clauses) > MAX_CLAUSES:
+        msg = 'RAM predicates have at most {} clauses'.format(MAX_CLAUSES)
+        raise ValueError(msg)
+    conditions = []
+    for index, clause in enumerate(clauses):
+        for condition in clause:
+            address, op, value = condition[:3]
+            mask = condition[3] if len(condition) > 3 else 0xFF
+            if op not in RAM_OPS:
+                msg = 'valid RAM comparisons are: {}'.format(', '.join(RAM_OPS))
+                raise ValueError(msg)
+            op = RAM_OPS.index(op)
+            conditions.append(_RamCondition(address, op, value, mask, index))
+    return (_RamCondition * len(conditions))(*conditions)
+
+
+class _RewardTerm(ctypes.Structure):
+    """A term of a reward from RAM (RewardTerm in rollout.hpp)."""
+    _fields_ = [
+        ('address', ctypes.c_uint16),
+        ('length', ctypes.c_uint8),
+        ('format', ctypes.c_uint8),
+        ('weight', ctypes.c_float),
+    ]
+
+
+# the encodings of the values of reward terms (in the order of RewardFormat)
+REWARD_FORMATS = ['little', 'big', 'digits']
+# setup the argument and return types for NESEnv_rollout
+_LIB.NESEnv_rollout.argtypes = [
+    ctypes.c_void_p,
+    ctypes.c_void_p,
+    ctypes.c_int,
+    ctypes.c_int,
+    ctypes.POINTER(_RewardTerm),
+    ctypes.c_int,
+    ctypes.POINTER(_RamCondition),
+    ctypes.c_int,
+    ctypes.c_int,
+    ctypes.c_void_p,
+    ctypes.c_void_p,
+    ctypes.c_void_p,
+]
+_LIB.NESEnv_rollout.restype = None
+# setup the argument and return types for NESEnv_step_batch
+_LIB.NESEnv_step_batch.argtypes = [
+    ctypes.POINTER(ctypes.c_void_p),
+    ctypes.c_int,
+    ctypes.c_void_p,
+    ctypes.c_int,
+    ctypes.POINTER(_RewardTerm),
+    ctypes.c_int,
+    ctypes.POINTER(_RamCondition),
+    ctypes.c_int,
+    ctypes.POINTER(_RewardTerm),
+    ctypes.POINTER(ctypes.c_int),
+    ctypes.c_int,
+    ctypes.c_void_p,
+    ctypes.c_void_p,
+    ctypes.c_void_p,
+    ctypes.c_void_p,
+    ctypes.c_void_p,
+    ctypes.c_void_p,
+]
+_LIB.NESEnv_step_batch.restype = None
+# setup the argument and return types for NESEnv_set_step_spec
+_LIB.NESEnv_set_step_spec.argtypes = [
+    ctypes.c_void_p,
+    ctypes.POINTER(_RewardTerm),
+    ctypes.c_int,
+    ctypes.POINTER(_RamCondition),
+    ctypes.c_int,
+    ctypes.POINTER(_RewardTerm),
+    ctypes.POINTER(ctypes.c_int),
+    ctypes.c_int,
+]
+_LIB.NESEnv_set_step_spec.restype = None
+# setup the argument and return types for NESEnv_read_ram_batch
+_LIB.NESEnv_read_ram_batch.argtypes = [
+    ctypes.POINTER(ctypes.c_void_p),
+    ctypes.c_int,
+    ctypes.c_void_p,
+    ctypes.c_void_p,
+]
+_LIB.NESEnv_read_ram_batch.restype = None
+
+
+def _check_reward_term(size, encoding):
+    """
+    Raise a ValueError if a term of a reward from RAM is invalid.
+
+    Args:
+        size (int): the number of bytes of the value of the term
+        encoding (str): the format of the value of the term
+
+    Returns:
+        None
+
+    """
+    if encoding not in REWARD_FORMATS:
+        msg = 'valid reward formats are: {}'.format(', '.join(REWARD_FORMATS))
+        raise ValueError(msg)
+    if not 1 <= size <= 8:
+        raise ValueError('reward terms must be 1 to 8 bytes long')
+
+
+def _reward_terms(terms):
+    """
+    Return the native terms of a reward from RAM.
+
+    Args:
+        terms (list): the terms as tuples of (address, length, format,
+            weight) where format is in REWARD_FORMATS
+
+    Returns:
+        a ctypes array of _RewardTerm
+
+    """
+    native = []
+    for address, size, encoding, weight in terms:
+        _check_reward_term(size, encoding)
+        native.append(_RewardTerm(address, size, REWARD_FORMATS.index(encoding), weight))
+    return (_RewardTerm * len(native))(*native)
+
+
+# the layout of a write to a watched address (WatchEvent in watchpoints.hpp)
+WATCH_EVENT_DTYPE = np.dtype([
+    ('frame', np.uint32),
+    ('address', np.uint16),
+    ('old_value', np.uint8),
+    ('value', np.uint8),
+])
+# setup the argument and return types for NESEnv_watch
+_LIB.NESEnv_watch.argtypes = [ctypes.c_void_p, ctypes.c_ushort, ctypes.c_bool]
+_LIB.NESEnv_watch.restype = ctypes.c_bool
+# setup the argument and return types for NESEnv_max_watch_events
+_LIB.NESEnv_max_watch_events.argtypes = None
+_LIB.NESEnv_max_watch_events.restype = ctypes.c_uint
+# setup the argument and return types for NESEnv_watch_events
+_LIB.NESEnv_watch_events.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.POINTER(ctypes.c_uint)]
+_LIB.NESEnv_watch_events.restype = ctypes.c_uint
+# setup the argument and return types for InputLog_read
+_LIB.InputLog_read.argtypes = [ctypes.c_char_p]
+_LIB.InputLog_read.restype = ctypes.c_void_p
+# setup the argument and return types for InputLog_frames
+_LIB.InputLog_frames.argtypes = [ctypes.c_void_p]
+_LIB.InputLog_frames.restype = ctypes.c_uint
+# setup the argument and return types for InputLog_rom_hash
+_LIB.InputLog_rom_hash.argtypes = [ctypes.c_void_p]
+_LIB.InputLog_rom_hash.restype = ctypes.c_uint64
+# setup the argument and return types for InputLog_close
+_LIB.InputLog_close.argtypes = [ctypes.c_void_p]
+_LIB.InputLog_close.restype = None
+# setup the argument and return types for NESEnv_rom_hash
+_LIB.NESEnv_rom_hash.argtypes = [ctypes.c_void_p]
+_LIB.NESEnv_rom_hash.restype = ctypes.c_uint64
+# setup the argument and return types for NESEnv_save_state_file
+_LIB.NESEnv_save_state_file.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+_LIB.NESEnv_save_state_file.restype = ctypes.c_bool
+# setup the argument and return types for NESEnv_load_state_file
+_LIB.NESEnv_load_state_file.argtypes = [ctypes.c_void_p, ctypes.c_void_p]
+_LIB.NESEnv_load_state_file.restype = ctypes.c_bool
+# setup the argument and return types for StateFile_open
+_LIB.StateFile_open.argtypes = [ctypes.c_char_p]
+_LIB.StateFile_open.restype = ctypes.c_void_p
+# setup the argument and return types for StateFile_rom_hash
+_LIB.StateFile_rom_hash.argtypes = [ctypes.c_void_p]
+_LIB.StateFile_rom_hash.restype = ctypes.c_uint64
+# setup the argument and return types for StateFile_close
+_LIB.StateFile_close.argtypes = [ctypes.c_void_p]
+_LIB.StateFile_close.restype = None
+# setup the argument and return types for StateArchive_open
+_LIB.StateArchive_open.argtypes = [ctypes.c_char_p, ctypes.c_uint64]
+_LIB.StateArchive_open.restype = ctypes.c_void_p
+# setup the argument and return types for StateArchive_size
+_LIB.StateArchive_size.argtypes = [ctypes.c_void_p]
+_LIB.StateArchive_size.restype = ctypes.c_uint
+# setup the argument and return types for StateArchive_keys
+_LIB.StateArchive_keys.argtypes = [ctypes.c_void_p, ctypes.c_void_p]
+_LIB.StateArchive_keys.restype = None
+# setup the argument and return types for StateArchive_contains
+_LIB.StateArchive_contains.argtypes = [ctypes.c_void_p, ctypes.c_uint64]
+_LIB.StateArchive_contains.restype = ctypes.c_bool
+# setup the argument and return types for StateArchive_metadata
+_LIB.StateArchive_metadata.argtypes = [ctypes.c_void_p, ctypes.c_uint64, ctypes.c_void_p, ctypes.c_uint]
+_LIB.StateArchive_metadata.restype = ctypes.c_int64
+# setup the argument and return types for StateArchive_add
+_LIB.StateArchive_add.argtypes = [
+    ctypes.c_void_p,
+    ctypes.c_void_p,
+    ctypes.c_void_p,
+    ctypes.c_int,
+    ctypes.c_bool,
+    ctypes.c_void_p,
+    ctypes.c_uint,
+    ctypes.c_bool,
+    ctypes.c_void_p,
+]
+_LIB.StateArchive_add.restype = None
+# setup the argument and return types for StateArchive_restore
+_LIB.StateArchive_restore.argtypes = [
+    ctypes.c_void_p,
+    ctypes.c_void_p,
+    ctypes.c_void_p,
+    ctypes.c_int,
+    ctypes.c_void_p,
+]
+_LIB.StateArchive_restore.restype = None
+# setup the argument and return types for StateArchive_close
+_LIB.StateArchive_close.argtypes = [ctypes.c_void_p]
+_LIB.StateArchive_close.restype = None
+# setup the argument and return types for Sequence_load
+_LIB.Sequence_load.argtypes = [ctypes.c_void_p]
+_LIB.Sequence_load.restype = ctypes.c_uint32
+# setup the argument and return types for Sequence_store
+_LIB.Sequence_store.argtypes = [ctypes.c_void_p, ctypes.c_uint32]
+_LIB.Sequence_store.restype = None
+# setup the argument and return types for Sequence_wait
+_LIB.Sequence_wait.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_int]
+_LIB.Sequence_wait.restype = ctypes.c_bool
 
 # height in pixels of the NES screen
 SCREEN_HEIGHT = _LIB.NESEnv_height()
@@ -64,6 +467,116 @@ SCREEN_WIDTH = _LIB.NESEnv_width()
 SCREEN_SHAPE_24_BIT = SCREEN_HEIGHT, SCREEN_WIDTH, 3
 # shape of the screen as 32-bit RGB (C++ memory arrangement)
 SCREEN_SHAPE_32_BIT = SCREEN_HEIGHT, SCREEN_WIDTH, 4
+# size in bytes of the RAM of the NES
+RAM_SIZE = 0x800
+# size in bytes of the PRG RAM window at $6000-$7FFF
+PRG_RAM_SIZE = 0x2000
+
+
+# the operations with latency histograms (LatencyOp in latency.hpp)
+LATENCY_OPS = ['step', 'backup', 'restore', 'screen']
+# the pixel formats of rendered frames (in the order of the C++ PixelFormat)
+PIXEL_FORMATS = ['rgb', 'gray', 'index']
+
+
+def counters_enabled():
+    """Return True if the hardware counters are compiled into the library."""
+    return _LIB.NESEnv_counters_enabled()
+
+
+def start_trace():
+    """Start recording a timeline of the operations of all environments."""
+    _LIB.Trace_start()
+
+
+def stop_trace(path):
+    """
+    Stop recording the timeline and write it as Chrome trace-event JSON.
+
+    The file opens in chrome://tracing or https://ui.perfetto.dev and shows
+    each step, backup, restore, and screen copy on the thread it ran on.
+
+    Args:
+        path (str): the path of the JSON file to write
+
+    Returns:
+        None
+
+    """
+    if not _LIB.Trace_stop(path.encode('utf-8')):
+        raise IOError('failed to write trace to {}'.format(path))
+
+
+def read_ram(envs, ram=None, prg_ram=None):
+    """
+    Copy the RAM of a batch of environments into rows of an array.
+
+    The RAM of all the environments is read in one native call, so
+    features of the batch (e.g., with `ram_values`) don't need a call per
+    environment and byte.
+
+    Args:
+        envs (list): the environments to read
+        ram (np.ndarray): the (len(envs), RAM_SIZE) uint8 array to copy the
+            RAM into. a new array if None
+        prg_ram (np.ndarray): the (len(envs), PRG_RAM_SIZE) uint8 array to
+            copy the PRG RAM at $6000-$7FFF into (zeros past the PRG RAM of
+            a cartridge), or None to skip the PRG RAM
+
+    Returns:
+        the array of RAM
+
+    """
+    shape = (len(envs), RAM_SIZE)
+    if ram is None:
+        ram = np.empty(shape, dtype=np.uint8)
+    for array, size in ((ram, RAM_SIZE), (prg_ram, PRG_RAM_SIZE)):
+        if array is None:
+            continue
+        if array.shape != (len(envs), size) or array.dtype != np.uint8:
+            raise ValueError('RAM buffers must be uint8 with a row per env')
+        if not array.flags['C_CONTIGUOUS']:
+            raise ValueError('RAM buffers must be C-contiguous')
+    handles = (ctypes.c_void_p * len(envs))(*[env.unwrapped._env for env in envs])
+    prg_pointer = None if prg_ram is None else prg_ram.ctypes.data
+    _LIB.NESEnv_read_ram_batch(handles, len(envs), ram.ctypes.data, prg_pointer)
+    return ram
+
+
+def ram_values(ram, terms):
+    """
+    Return the weighted sum of values in each row of RAM.
+
+    The terms are evaluated like the native rewards (see `NESEnv._rollout`)
+    but vectorized over the rows, so a feature of a batch of environments
+    (e.g., the score, the X position, or the lives) takes one pass.
+
+    Args:
+        ram (np.ndarray): the (..., RAM_SIZE) RAM (e.g., from `read_ram`)
+        terms (list): the terms as tuples of (address, length, format,
+            weight) where format is in REWARD_FORMATS
+
+    Returns:
+        an array of the weighted sum of each row (float64)
+
+    """
+    ram = np.asarray(ram)
+    total = np.zeros(ram.shape[:-1])
+    for address, size, encoding, weight in terms:
+        _check_reward_term(size, encoding)
+        # the addresses wrap like the mirrors of the RAM
+        data = ram[..., (address + np.arange(size)) % RAM_SIZE].astype(np.uint64)
+        if encoding == 'little':
+            places = np.uint64(256) ** np.arange(size, dtype=np.uint64)
+        elif encoding == 'big':
+            places = np.uint64(256) ** np.arange(size - 1, -1, -1, dtype=np.uint64)
+        else:
+            data %= np.uint64(10)
+            places = np.uint64(10) ** np.arange(size - 1, -1, -1, dtype=np.uint64)
+        value = (data * places).sum(axis=-1, dtype=np.uint64)
+        # the weights are single precision natively
+        total += float(np.float32(weight)) * value.astype(np.float64)
+    return total
 
 
 # the magic bytes expected at the first four bytes of the iNES ROM header.
@@ -151,15 +664,54 @@ class NESEnv(gym.Env):
         self._screen_data = np.empty(SCREEN_SHAPE_32_BIT, dtype=np.uint8)
         # setup the screen for the environment (24-bit RGB format for Python)
         self.screen = np.empty(SCREEN_SHAPE_24_BIT, dtype=np.uint8)
+        # create two frames for asynchronous steps to alternate between
+        self._async_screen_data = [
+            np.empty(SCREEN_SHAPE_32_BIT, dtype=np.uint8),
+            np.empty(SCREEN_SHAPE_32_BIT, dtype=np.uint8),
+        ]
+        # the index of the frame the latest asynchronous step writes to
+        self._async_index = 0
+        # the action of the latest asynchronous step
+        self._async_action = 0
+        # whether the latest asynchronous step runs all its frames natively
+        self._async_native = True
+        # the native reward, done, and info of asynchronous steps (see
+        # _set_step_spec) and the buffers for their outputs
+        self._step_spec = None
+        self._async_reward = np.zeros(1, dtype=np.float64)
+        self._async_done = np.zeros(1, dtype=np.uint8)
+        self._async_infos = np.zeros(1, dtype=np.float64)
         # determines whether the env has a backup stored
         self._has_backup = False
+        # whether the emulator renders frames to the screen
+        self._render = True
+        # the buffer for symbolic observations of the screen
+        self._symbolic = _SymbolicObservation()
+        # the buffer for writes to watched addresses (allocated on demand)
+        self._watch_events = None
 
     def _copy_screen(self):
         """Copy screen data from the C++ shared object library."""
+        # the screen doesn't change while rendering is disabled
+        if not self._render:
+            return
         # fill the screen data array with values from the emulator
         _LIB.NESEnv_screen(self._env, as_ctypes(self._screen_data))
+        self._set_screen(self._screen_data)
+
+    def _set_screen(self, screen_data):
+        """
+        Set the screen to a view of 32-bit screen data from the emulator.
+
+        Args:
+            screen_data (np.ndarray): the 32-bit screen data to view
+
+        Returns:
+            None
+
+        """
         # copy the screen data to the screen
-        self.screen = self._screen_data
+        self.screen = screen_data
         # flip the bytes if the machine is little-endian (which it likely is)
         if self._is_little_endian:
             # invert the little-endian BGR channels to RGB
@@ -207,6 +759,140 @@ class NESEnv(gym.Env):
         """
         _LIB.NESEnv_step(self._env, action)
 
+    def _run_until(self, action, clauses, max_frames, per_instruction=False):
+        """
+        Advance frames with an action until a predicate on the RAM holds.
+
+        The predicate holds when all the conditions of any of its clauses do.
+        A condition is a tuple of (address, op, value) or (address, op,
+        value, mask) where op is one of RAM_OPS and the mask selects the bits
+        of the byte to compare. 'changed' compares the masked byte with its
+        value when the call started (the value is ignored), e.g.:
+
+            # until $0770 is 1 and $0772 is 3, or $075A changes
+            env._run_until(0, [
+                [(0x0770, '==', 1), (0x0772, '==', 3)],
+                [(0x075A, 'changed', 0)],
+            ], max_frames=600)
+
+        Args:
+            action (byte): the bitmap determining which buttons to press
+            clauses (list): a list of clauses as lists of conditions
+            max_frames (int): the largest number of frames to advance
+            per_instruction (bool): whether to test the predicate after each
+                instruction (to catch values that only last part of a frame)
+                instead of after each frame. The frame the predicate holds in
+                still runs to the end
+
+        Returns:
+            a tuple of:
+            - the number of frames advanced (0 if the predicate already held)
+            - the index of the clause that held, or None if none did in time
+
+        """
+        conditions = _ram_conditions(clauses)
+        clause = ctypes.c_int()
+        frames = _LIB.NESEnv_run_until(self._env, action, conditions,
+            len(conditions), max_frames, per_instruction, ctypes.byref(clause))
+        self._copy_screen()
+        return frames, (clause.value if clause.value >= 0 else None)
+
+    def _watch(self, addresses, enabled=True):
+        """
+        Watch or stop watching the writes of the game to addresses.
+
+        Writes to watched addresses are buffered natively until drained by
+        `_drain_watch_events`, which is cheaper than polling the addresses
+        with `_read_mem` after each frame.
+
+        Args:
+            addresses (iterable): the addresses to watch in RAM ($0000-$1FFF,
+                watching their mirrors) or PRG-RAM ($6000-$7FFF)
+            enabled (bool): whether to watch or stop watching the addresses
+
+        Returns:
+            None
+
+        """
+        addresses = list(addresses)
+        for address in addresses:
+            if not (0 <= address <= 0x1FFF or 0x6000 <= address <= 0x7FFF):
+                msg = 'can only watch RAM and PRG-RAM, not ${:04X}'
+                raise ValueError(msg.format(address))
+        for address in addresses:
+            _LIB.NESEnv_watch(self._env, address, enabled)
+
+    def _drain_watch_events(self):
+        """
+        Return and clear the writes to watched addresses since the last call.
+
+        Returns:
+            a tuple of:
+            - a structured array of WATCH_EVENT_DTYPE with the frame of each
+              write (counted from the last call), the address, the old value,
+              and the value written
+            - the number of writes dropped because the buffer was full
+
+        """
+        if self._watch_events is None:
+            size = _LIB.NESEnv_max_watch_events()
+            self._watch_events = np.empty(size, dtype=WATCH_EVENT_DTYPE)
+        dropped = ctypes.c_uint()
+        count = _LIB.NESEnv_watch_events(self._env,
+            self._watch_events.ctypes.data, ctypes.byref(dropped))
+        return self._watch_events[:count].copy(), dropped.value
+
+    def _rollout(self, actions, reward=(), done=(), workers=None):
+        """
+        Run open-loop rollouts of action sequences from the current state.
+
+        The rollouts run natively in parallel worker processes with rendering
+        disabled. The environment is left in its current state. The reward of
+        a frame is the weighted change of values in RAM, e.g., for the score
+        and X position of Super Mario Bros.:
+
+            env._rollout(actions, reward=[
+                (0x07DD, 6, 'digits', 10),  # the score (10s in 6 digits)
+                (0x006D, 1, 'little', 256), # the page of the X position
+                (0x0086, 1, 'little', 1),   # the X position in the page
+            ], done=[[(0x000E, '==', 0x0B)]])  # the player is dying
+
+        Args:
+            actions (np.ndarray): the (rollouts, length) matrix of actions
+            reward (list): the terms of the reward as tuples of (address,
+                length, format, weight) where format is in REWARD_FORMATS
+            done (list): the clauses of a RAM predicate (see `_run_until`)
+                that ends a rollout early, tested after each frame
+            workers (int): the number of worker processes (1 runs the
+                rollouts in this process), or None for the number of CPUs.
+                The workers are forked from this process for each call, so
+                they start from its state without copying it, at a cost of
+                about a millisecond each: use 1 for calls that run only a few
+                frames per worker
+
+        Returns:
+            a tuple of:
+            - the reward of each rollout (np.ndarray of float64)
+            - the number of frames each rollout ran (np.ndarray of uint32)
+            - the (rollouts, 2048) RAM after each rollout (np.ndarray of uint8)
+
+        """
+        actions = np.ascontiguousarray(actions, dtype=np.uint8)
+        if actions.ndim != 2:
+            raise ValueError('actions should be a (rollouts, length) matrix')
+        rollouts, length = actions.shape
+        terms = _reward_terms(reward)
+        conditions = _ram_conditions(done)
+        if workers is None:
+            workers = multiprocessing.cpu_count()
+        rewards = np.zeros(rollouts, dtype=np.float64)
+        frames = np.zeros(rollouts, dtype=np.uint32)
+        final_ram = np.zeros((rollouts, 0x800), dtype=np.uint8)
+        _LIB.NESEnv_rollout(self._env, actions.ctypes.data, rollouts, length,
+            terms, len(terms), conditions, len(conditions), workers,
+            rewards.ctypes.data, frames.ctypes.data, final_ram.ctypes.data)
+        return rewards, frames, final_ram
+
     def _backup(self):
         """Backup the NES state in the emulator."""
         _LIB.NESEnv_backup(self._env)
@@ -221,6 +907,360 @@ class NESEnv(gym.Env):
         _LIB.NESEnv_restore(self._env)
         self._copy_screen()
 
+    def clone(self):
+        """
+        Return a new environment in the same state as this one.
+
+        The clone shares the ROM of this environment and copies only its
+        mutable state, so it's much cheaper than loading the ROM again. The
+        attributes of the Python object (e.g., of a subclass) are copied
+        shallowly.
+
+        Returns:
+            a new environment of the same class in the state of this one
+
+        """
+        clone = copy.copy(self)
+        clone._env = _LIB.NESEnv_clone(self._env)
+        # the clone needs buffers of its own
+        clone.viewer = None
+        clone._screen_data = np.empty(SCREEN_SHAPE_32_BIT, dtype=np.uint8)
+        clone.screen = self.screen.copy()
+        clone._async_screen_data = [
+            np.empty(SCREEN_SHAPE_32_BIT, dtype=np.uint8),
+            np.empty(SCREEN_SHAPE_32_BIT, dtype=np.uint8),
+        ]
+        clone._has_backup = False
+        clone._symbolic = _SymbolicObservation()
+        clone._watch_events = None
+        clone._async_reward = np.zeros(1, dtype=np.float64)
+        clone._async_done = np.zeros(1, dtype=np.uint8)
+        clone._async_infos = self._async_infos.copy()
+        if self._step_spec is not None:
+            clone._set_step_spec(*self._step_spec)
+        return clone
+
+    def broadcast(self, envs):
+        """
+        Copy the state of this environment into other environments.
+
+        The state is serialized once and only the mutable state of the
+        machine is copied into each environment, along with the screen and
+        the step count. Other attributes of the Python objects are unchanged.
+
+        Args:
+            envs (list): the environments (of the same ROM) to copy into
+
+        Returns:
+            None
+
+        """
+        rom_hash = _LIB.NESEnv_rom_hash(self._env)
+        if any(_LIB.NESEnv_rom_hash(env._env) != rom_hash for env in envs):
+            raise ValueError('envs must be for the same ROM as the source')
+        targets = (ctypes.c_void_p * len(envs))(*[env._env for env in envs])
+        if not _LIB.NESEnv_broadcast(self._env, targets, len(envs)):
+            raise RuntimeError('failed to load the state into the envs')
+        for env in envs:
+            if env is not self:
+                env.screen = self.screen.copy()
+                env._steps = self._steps
+
+    def _set_render(self, enabled):
+        """
+        Enable or disable rendering frames to the screen.
+
+        Emulation is unaffected, but the screen keeps the last rendered frame
+        while rendering is disabled.
+
+        Args:
+            enabled (bool): whether to render frames
+
+        Returns:
+            None
+
+        """
+        self._render = enabled
+        _LIB.NESEnv_set_render(self._env, enabled)
+
+    def _observe(self):
+        """
+        Return a symbolic observation of the screen read from PPU memory.
+
+        It works with rendering disabled and is about 100x smaller than a
+        frame. The background is the 32x30 grid of tiles at the coarse scroll
+        of the last scroll write (the last split in split-screen games).
+
+        Returns:
+            a dictionary with:
+            - tiles (np.ndarray): the (30, 32) pattern indexes of the tiles
+            - palettes (np.ndarray): the (30, 32) palettes (0-3) of the tiles
+            - sprites (np.ndarray): the (64, 4) OAM sprites as Y, pattern
+              index, attributes, and X
+            - scroll (np.ndarray): the fine scroll (0-7) in X and Y
+            - tables (np.ndarray): the pattern tables of the background and
+              sprites, and the sprite height
+
+        """
+        symbolic = self._symbolic
+        _LIB.NESEnv_observe(self._env, ctypes.byref(symbolic))
+        return {
+            'tiles': np.ctypeslib.as_array(symbolic.tiles).copy(),
+            'palettes': np.ctypeslib.as_array(symbolic.palettes).copy(),
+            'sprites': np.ctypeslib.as_array(symbolic.sprites).copy(),
+            'scroll': np.array([symbolic.fine_x, symbolic.fine_y], dtype=np.uint8),
+            'tables': np.array([
+                symbolic.bg_table,
+                symbolic.sprite_table,
+                symbolic.sprite_height
+            ], dtype=np.uint8),
+        }
+
+    def _set_pixel_format(self, pixel_format):
+        """
+        Set the format of the pixels in the frames rendered after this call.
+
+        Args:
+            pixel_format (str): the format of the pixels:
+            - rgb: the RGB colors (the default)
+            - gray: the luminance of the colors in each channel
+            - index: the NES palette index (0-63) in each channel
+
+        Returns:
+            None
+
+        """
+        if pixel_format not in PIXEL_FORMATS:
+            msg = 'valid pixel formats are: {}'.format(', '.join(PIXEL_FORMATS))
+            raise ValueError(msg)
+        _LIB.NESEnv_set_pixel_format(self._env, PIXEL_FORMATS.index(pixel_format))
+
+    def _record(self, keyframe_interval=600):
+        """
+        Start recording the joy-pad inputs of each frame to an input log.
+
+        Args:
+            keyframe_interval (int): the number of frames between keyframes
+
+        Returns:
+            None
+
+        """
+        _LIB.NESEnv_record(self._env, keyframe_interval)
+
+    def _stop_recording(self, path=None):
+        """
+        Stop recording and write the input log to a file.
+
+        Args:
+            path (str): the path of the file to write, or None to discard
+
+        Returns:
+            None
+
+        """
+        if path is not None:
+            path = path.encode('utf-8')
+        if not _LIB.NESEnv_stop_recording(self._env, path) and path is not None:
+            raise IOError('failed to write input log to {}'.format(path))
+
+    def _seek(self, log, frame):
+        """
+        Seek to the state after a frame of an input log.
+
+        Args:
+            log (InputLog): the input log to replay
+            frame (int): the number of frames of the log to replay
+
+        Returns:
+            None
+
+        """
+        if log.rom_hash != _LIB.NESEnv_rom_hash(self._env):
+            raise ValueError('input log is for another ROM')
+        if not _LIB.NESEnv_seek(self._env, log._log, frame):
+            raise ValueError('frame {} is not in the input log'.format(frame))
+        self._copy_screen()
+
+    def _save_state(self, path):
+        """
+        Write the machine state to a save-state file.
+
+        The file can be loaded by any environment of the same ROM with
+        `_load_state`, e.g., as a start state on another machine.
+
+        Args:
+            path (str): the path of the file to write
+
+        Returns:
+            None
+
+        """
+        if not _LIB.NESEnv_save_state_file(self._env, path.encode('utf-8')):
+            raise IOError('failed to write save state to {}'.format(path))
+
+    def _load_state(self, state):
+        """
+        Load the machine state from a save-state file.
+
+        Args:
+            state (SaveState, str): an open save-state (fastest to load many
+                times) or the path of a save-state file
+
+        Returns:
+            None
+
+        """
+        from .save_state import SaveState
+        if not isinstance(state, SaveState):
+            with SaveState(state) as opened:
+                return self._load_state(opened)
+        if state.rom_hash != _LIB.NESEnv_rom_hash(self._env):
+            raise ValueError('save state is for another ROM')
+        if not _LIB.NESEnv_load_state_file(self._env, state._file):
+            raise ValueError('save state is corrupt')
+        self._copy_screen()
+
+    def _set_reset_state(self, state=None):
+        """
+        Set the golden post-boot state that resets load for this ROM.
+
+        Resets of every environment of the ROM in the process (including
+        the native auto-resets) load the state in place instead of powering
+        on the machine, so boot and title screens only run once. Capture
+        the state after getting through them, e.g., in `__init__`.
+
+        Args:
+            state (SaveState, str): an open save-state or the path of a
+                save-state file, or None to use the current state
+
+        Returns:
+            None
+
+        """
+        if state is None:
+            return _LIB.NESEnv_set_reset_state(self._env)
+        from .save_state import SaveState
+        if not isinstance(state, SaveState):
+            with SaveState(state) as opened:
+                return self._set_reset_state(opened)
+        if not _LIB.NESEnv_set_reset_state_file(self._env, state._file):
+            raise ValueError('save state is for another ROM or is corrupt')
+
+    def _clear_reset_state(self):
+        """Remove the golden reset state of this ROM (resets power on)."""
+        _LIB.NESEnv_clear_reset_state(self._env)
+
+    @property
+    def _has_reset_state(self):
+        """Return True if this ROM has a golden reset state."""
+        return _LIB.NESEnv_has_reset_state(self._env)
+
+    def _profile(self, interval=1):
+        """
+        Start profiling the opcodes and program counters of the guest code.
+
+        Args:
+            interval (int): the number of instructions between samples. 1
+                counts every instruction exactly
+
+        Returns:
+            None
+
+        """
+        _LIB.NESEnv_profile(self._env, interval)
+
+    def _stop_profile(self, path=None):
+        """
+        Stop profiling and write the profile to a text file.
+
+        The file lists the opcode histogram and the PC heat map sorted by
+        the number of samples. PRG-ROM addresses are listed by 8KB bank,
+        CPU address, and offset in the iNES file.
+
+        Args:
+            path (str): the path of the file to write, or None to discard
+
+        Returns:
+            None
+
+        """
+        if path is not None:
+            path = path.encode('utf-8')
+        if not _LIB.NESEnv_stop_profile(self._env, path) and path is not None:
+            raise IOError('failed to write profile to {}'.format(path))
+
+    def _latency(self, percentiles=(50, 99, 99.9)):
+        """
+        Return the latency histograms of the native operations.
+
+        The latencies of step, backup, restore, and screen copies are
+        measured inside the emulator, so they exclude Python and FFI time.
+
+        Args:
+            percentiles (tuple): the percentiles to compute
+
+        Returns:
+            a dictionary of operation names to dictionaries with the count,
+            mean, max, and each percentile (e.g., 'p99.9') in nanoseconds
+
+        """
+        percents = (ctypes.c_double * len(percentiles))(*percentiles)
+        output = (ctypes.c_double * (3 + len(percentiles)))()
+        latency = {}
+        for op, name in enumerate(LATENCY_OPS):
+            _LIB.NESEnv_latency(self._env, op, percents, len(percentiles), output)
+            summary = {'count': int(output[0]), 'mean': output[1], 'max': output[2]}
+            for i, percent in enumerate(percentiles):
+                summary['p{:g}'.format(percent)] = output[3 + i]
+            latency[name] = summary
+        return latency
+
+    def _reset_latency(self):
+        """Remove the recorded latencies of the native operations."""
+        _LIB.NESEnv_reset_latency(self._env)
+
+    def _counters(self, reset=False):
+        """
+        Return the hardware counters of the emulator for this environment.
+
+        The counters are only updated when the library is compiled with
+        NES_COUNTERS defined (e.g., `scons counters=1`).
+
+        Args:
+            reset (bool): whether to reset the counters to zero after reading
+
+        Returns:
+            a dictionary of counter names to counts, or None if the counters
+            aren't compiled in
+
+        """
+        if not counters_enabled():
+            return None
+        counters = _Counters()
+        _LIB.NESEnv_counters(self._env, ctypes.byref(counters))
+        if reset:
+            _LIB.NESEnv_reset_counters(self._env)
+        return {name: getattr(counters, name) for name, _ in counters._fields_}
+
+    def _memory_footprint(self):
+        """
+        Return the memory footprint of this environment in bytes.
+
+        Returns:
+            a dictionary of:
+            - instance: the environment object (e.g., latency histograms)
+            - state: the game-state (CPU, PPU, joy-pad, and mapper RAM)
+            - backup: the backup game-state and framebuffer (0 without one)
+            - framebuffer: the video buffer and the screen
+            - serialized: a snapshot of the state (e.g., in an archive)
+            - shared: the ROM and decoded CHR-ROM tiles (shared with clones)
+
+        """
+        footprint = _MemoryFootprint()
+        _LIB.NESEnv_footprint(self._env, ctypes.byref(footprint))
+        return {name: getattr(footprint, name) for name, _ in footprint._fields_}
+
     def _will_reset(self):
         """Handle any RAM hacking after a reset occurs."""
         pass
@@ -239,7 +1279,9 @@ class NESEnv(gym.Env):
         self._will_reset()
         # reset the emulator
         if not self._has_backup:
-            _LIB.NESEnv_reset(self._env)
+            if not _LIB.NESEnv_reset(self._env):
+                msg = 'golden reset state failed to load, powered on instead'
+                warnings.warn(msg, RuntimeWarning)
         else:
             self._restore()
         # call the after reset callback
@@ -289,6 +1331,135 @@ class NESEnv(gym.Env):
         self._did_step(done)
         # copy the screen from the emulator
         self._copy_screen()
+        return self._step_output(reward, done, info)
+
+    def _set_step_spec(self, reward=(), done=(), info=None):
+        """
+        Set the native reward, done, and info of asynchronous steps.
+
+        With a specification, `step_wait` returns the reward, done flag, and
+        info values computed from RAM natively (like the native steps of
+        `SharedMemoryVectorEnv`) instead of calling `_get_reward`,
+        `_get_done`, and `_get_info`.
+
+        Args:
+            reward (list): the terms of the reward (see `_rollout`)
+            done (list): the clauses of a RAM predicate (see `_run_until`)
+                that ends an episode, tested after each frame
+            info (dict): the terms of each info value by its key
+
+        Returns:
+            None
+
+        """
+        info = dict(info or {})
+        keys = tuple(info)
+        info = [info[key] for key in keys]
+        reward_terms = _reward_terms(reward)
+        conditions = _ram_conditions(done)
+        info_terms = _reward_terms([term for terms in info for term in terms])
+        info_sizes = (ctypes.c_int * len(info))(*[len(terms) for terms in info])
+        _LIB.NESEnv_set_step_spec(self._env, reward_terms, len(reward_terms),
+            conditions, len(conditions), info_terms, info_sizes, len(info_sizes))
+        self._step_spec = (list(reward), list(done), dict(zip(keys, info)))
+        self._async_infos = np.zeros(max(1, len(keys)), dtype=np.float64)
+
+    def _has_step_callbacks(self):
+        """Return True if the reward, done, or info callbacks are overridden."""
+        return any(
+            getattr(type(self), name) is not getattr(NESEnv, name)
+            for name in ['_get_reward', '_get_done', '_get_info']
+        )
+
+    def step_async(self, action):
+        """
+        Start running the frames of a step in the background and return.
+
+        The emulator runs on a native thread without holding the GIL. The
+        environment should not be used again until `step_wait` returns.
+
+        All the frames of the step run natively when the reward, done, and
+        info come from a native specification (see `_set_step_spec`) or
+        the callbacks (`_get_reward`, `_get_done`, and `_get_info`) aren't
+        overridden. Otherwise the callbacks have to run between frames, so
+        only the first frame runs in the background and `step_wait` runs
+        the rest of the frames of the step like `step`.
+
+        Args:
+            action (byte): the bitmap determining which buttons to press
+
+        Returns:
+            None
+
+        """
+        # alternate frames so the last observation stays valid meanwhile
+        self._async_index = 1 - self._async_index
+        self._async_action = action
+        self._async_native = self._step_spec is not None or not self._has_step_callbacks()
+        frames = self._frames_per_step if self._async_native else 1
+        screen_data = self._async_screen_data[self._async_index]
+        _LIB.NESEnv_step_async(self._env, action, frames, as_ctypes(screen_data),
+            self._async_reward.ctypes.data, self._async_done.ctypes.data,
+            self._async_infos.ctypes.data)
+
+    def step_wait(self):
+        """
+        Wait for the step started by `step_async` and return its output.
+
+        The output matches `step` for any frames_per_step. Without a native
+        specification, the reward, done, and info callbacks run after each
+        frame (see `step_async`).
+
+        Returns:
+            a tuple of:
+            - state (np.ndarray): next frame as a result of the given action
+            - reward (float) : amount of reward returned after given action
+            - done (boolean): whether the episode has ended
+            - info (dict): contains auxiliary diagnostic information
+
+        """
+        _LIB.NESEnv_step_wait(self._env)
+        screen_data = self._async_screen_data[self._async_index]
+        if self._step_spec is not None:
+            reward = float(self._async_reward[0])
+            done = bool(self._async_done[0])
+            info = dict(zip(self._step_spec[2], self._async_infos.tolist()))
+        else:
+            # the callbacks are either constant or run after the first frame
+            reward = self._get_reward()
+            done = self._get_done()
+            info = self._get_info()
+        if not self._async_native:
+            # run the rest of the frames of the step like `step` does
+            frames = 1
+            while frames < self._frames_per_step and not done:
+                _LIB.NESEnv_step(self._env, self._async_action)
+                frames += 1
+                reward += self._get_reward()
+                done = self._get_done()
+                info = self._get_info()
+            # the screen doesn't change while rendering is disabled
+            if frames > 1 and self._render:
+                _LIB.NESEnv_screen(self._env, as_ctypes(screen_data))
+        # call the after step callback
+        self._did_step(done)
+        # view the frame the step copied the screen into
+        self._set_screen(screen_data)
+        return self._step_output(reward, done, info)
+
+    def _step_output(self, reward, done, info):
+        """
+        Finish a step and return the relevant observation data.
+
+        Args:
+            reward (float): the reward accumulated over the step
+            done (boolean): whether the episode has ended
+            info (dict): contains auxiliary diagnostic information
+
+        Returns:
+            a tuple of the screen, bounded reward, done flag, and info
+
+        """
         # increment the steps counter
         self._steps += 1
         # set the done flag to true if the steps are past the max
@@ -0,0 +1,48 @@
+"""Save-state files to start environments from anywhere."""
+from .nes_env import _LIB
+
+
+class SaveState(object):
+    """A save-state file written by NESEnv._save_state."""
+
+    def __init__(self, path):
+        """
+        Open a save-state file.
+
+        The file is memory-mapped read-only, so processes that open the same
+        file share its memory, and loading it copies the state directly.
+
+        Args:
+            path (str): the path to a file written by NESEnv._save_state
+
+        Returns:
+            None
+
+        """
+        self._file = _LIB.StateFile_open(path.encode('utf-8'))
+        if not self._file:
+            raise ValueError('{} is not a valid save state'.format(path))
+
+    def __enter__(self):
+        """Return the save state for a with statement."""
+        return self
+
+    def __exit__(self, *args):
+        """Close the save state at the end of a with statement."""
+        self.close()
+
+    @property
+    def rom_hash(self):
+        """Return the hash of the ROM the state is for."""
+        return _LIB.StateFile_rom_hash(self._file)
+
+    def close(self):
+        """Close the save state."""
+        if self._file is None:
+            raise ValueError('save state has already been closed.')
+        _LIB.StateFile_close(self._file)
+        self._file = None
+
+
+# explicitly define the outward facing API of this module
+__all__ = [SaveState.__name__]
@@ -0,0 +1,136 @@
+"""An append-only archive of states for exploration (e.g., Go-Explore cells)."""
+import ctypes
+import numpy as np
+from .nes_env import _LIB
+
+
+class StateArchive(object):
+    """An append-only, memory-mapped archive of states keyed by 64-bit hashes."""
+
+    def __init__(self, path, env):
+        """
+        Open an archive, creating it if it doesn't exist.
+
+        Only the records that are read are paged into memory, so archives can
+        be much larger than RAM. Adding a key again replaces its record in the
+        index (the file is append-only).
+
+        Args:
+            path (str): the path of the archive file
+            env (NESEnv): an environment of the ROM the states are for
+
+        Returns:
+            None
+
+        """
+        rom_hash = _LIB.NESEnv_rom_hash(env.unwrapped._env)
+        self._archive = _LIB.StateArchive_open(path.encode('utf-8'), rom_hash)
+        if not self._archive:
+            raise ValueError('{} is not a state archive of the ROM'.format(path))
+
+    def __enter__(self):
+        """Return the archive for a with statement."""
+        return self
+
+    def __exit__(self, *args):
+        """Close the archive at the end of a with statement."""
+        self.close()
+
+    def __len__(self):
+        """Return the number of keys in the archive."""
+        return _LIB.StateArchive_size(self._archive)
+
+    def __contains__(self, key):
+        """Return True if the archive has a key."""
+        return _LIB.StateArchive_contains(self._archive, key)
+
+    def keys(self):
+        """Return the keys of the archive in the order they were added."""
+        keys = np.empty(len(self), dtype=np.uint64)
+        _LIB.StateArchive_keys(self._archive, keys.ctypes.data)
+        return keys
+
+    def add(self, envs, keys=None, metadata=None, replace=False):
+        """
+        Append the states of environments to the archive.
+
+        Args:
+            envs (list): the environments to add the states of
+            keys (list): the 64-bit key of each state, or None to key the
+                states by their hashes (which deduplicates equal states)
+            metadata (np.ndarray): a (len(envs), size) array of bytes to store
+                with each state (e.g., score and trajectory length), or None
+            replace (bool): whether to replace the records of existing keys
+
+        Returns:
+            a tuple of:
+            - the keys of the states
+            - whether each state was added (False for existing keys unless
+              replace is True)
+
+        """
+        count = len(envs)
+        handles = (ctypes.c_void_p * count)(*[env.unwrapped._env for env in envs])
+        hash_keys = keys is None
+        keys = np.zeros(count, dtype=np.uint64) if hash_keys else np.array(keys, dtype=np.uint64)
+        if metadata is None:
+            metadata = np.zeros((count, 0), dtype=np.uint8)
+        metadata = np.ascontiguousarray(metadata, dtype=np.uint8).reshape(count, -1)
+        added = np.zeros(count, dtype=np.bool_)
+        _LIB.StateArchive_add(self._archive, handles, keys.ctypes.data, count,
+            hash_keys, metadata.ctypes.data, metadata.shape[1], replace,
+            added.ctypes.data)
+        return keys, added
+
+    def restore(self, envs, keys):
+        """
+        Load the state of each key into an environment.
+
+        Args:
+            envs (list): the environments to load the states into
+            keys (list): the key of the state to load into each environment
+
+        Returns:
+            None
+
+        """
+        count = len(envs)
+        handles = (ctypes.c_void_p * count)(*[env.unwrapped._env for env in envs])
+        keys = np.array(keys, dtype=np.uint64)
+        restored = np.zeros(count, dtype=np.bool_)
+        _LIB.StateArchive_restore(self._archive, handles, keys.ctypes.data,
+            count, restored.ctypes.data)
+        for env in envs:
+            env.unwrapped._copy_screen()
+        if not restored.all():
+            missing = keys[~restored].tolist()
+            raise KeyError('failed to restore keys {}'.format(missing))
+
+    def metadata(self, key):
+        """
+        Return the metadata of a key.
+
+        Args:
+            key (int): the key of the record
+
+        Returns:
+            (bytes) the metadata stored with the state
+
+        """
+        size = _LIB.StateArchive_metadata(self._archive, key, None, 0)
+        if size < 0:
+            raise KeyError(key)
+        output = ctypes.create_string_buffer(max(size, 1))
+        _LIB.StateArchive_metadata(self._archive, key, output, size)
+        return output.raw[:size]
+
+    def close(self):
+        """Close the archive."""
+        if self._archive is None:
+            raise ValueError('archive has already been closed.')
+        _LIB.StateArchive_close(self._archive)
+        self._archive = None
+
+
+# explicitly define the outward facing API of this module
+__all__ = [StateArchive.__name__]
@@ -0,0 +1,85 @@
+"""Test cases for the ActorService class."""
+import os
+from functools import partial
+from unittest import TestCase
+import numpy as np
+from ..nes_env import NESEnv
+from ..actor_service import ActorService
+
+
+# the path to the Super Mario Bros. ROM for the tests
+PATH = os.path.join(os.path.dirname(__file__), 'games/smb1.nes')
+# the frame counter of Super Mario Bros. as a reward term
+COUNTER = [(0x09, 1, 'little', 1)]
+
+
+class ShouldRaiseValueErrorOnInvalidDepth(TestCase):
+    def test(self):
+        env_fns = [partial(NESEnv, PATH)]
+        self.assertRaises(ValueError, ActorService, env_fns, 1, None, 3)
+
+
+class ShouldMatchSerialEnvs(TestCase):
+    def test(self):
+        num_envs = 3
+        # episodes end when the frame counter wraps around
+        service = ActorService([partial(NESEnv, PATH)] * num_envs, num_actors=2,
+            reward=COUNTER, done=[[(0x09, '==', 0)]], info={'frame': COUNTER})
+        serial = [NESEnv(PATH) for _ in range(num_envs)]
+        obs = service.reset()
+        self.assertEqual((num_envs, 240, 256, 3), obs.shape)
+        for idx in range(num_envs):
+            self.assertTrue(np.array_equal(serial[idx].reset(), obs[idx]))
+        episodes = 0
+        for step in range(300):
+            actions = [8 if step % 200 < 10 else (step + idx) % 256 for idx in range(num_envs)]
+            obs, rewards, dones, infos = service.step(actions)
+            for idx in range(num_envs):
+                state, _, _, _ = serial[idx].step(actions[idx])
+                frame = serial[idx]._read_mem(0x09)
+                self.assertEqual(frame, infos[idx]['frame'])
+                self.assertEqual(frame == 0, dones[idx])
+                if dones[idx]:
+                    episodes += 1
+                    terminal = infos[idx]['terminal_observation']
+                    self.assertTrue(np.array_equal(state, terminal))
+                    state = serial[idx].reset()
+                self.assertTrue(np.array_equal(state, obs[idx]), (step, idx))
+        self.assertGreater(episodes, 0)
+        service.close()
+        # trying to close again should raise an error
+        self.assertRaises(ValueError, service.close)
+        for serial_env in serial:
+            serial_env.close()
+
+
+class ShouldPipelineBatches(TestCase):
+    def test(self):
+        service = ActorService([partial(NESEnv, PATH)] * 2, num_actors=1,
+            depth=4, reward=COUNTER)
+        service.reset()
+        # keep several batches in flight and receive them in order
+        for tag in range(4):
+            service.send(0, [0, 0], tag=tag)
+        for tag in range(4):
+            received, obs, rewards, dones, _, _ = service.receive(0)
+            self.assertEqual(tag, received)
+            self.assertEqual((2, 240, 256, 3), obs.shape)
+            self.assertEqual(rewards[0], rewards[1])
+            self.assertTrue(np.array_equal(obs[0], obs[1]))
+            self.assertFalse(dones.any())
+            service.release(0)
+        service.close()
+
+
+class ShouldRaiseRuntimeErrorOnDeadActor(TestCase):
+    def test(self):
+        import signal
+        service = ActorService([partial(NESEnv, PATH)] * 2, num_actors=2,
+            reward=COUNTER)
+        service.reset()
+        # a killed actor never answers, so waiting on it raises
+        os.kill(service._procs[1].pid, signal.SIGKILL)
+        service._procs[1].join()
+        self.assertRaises(RuntimeError, service.step, [0, 0])
+        service.close()
@@ -0,0 +1,87 @@
+"""Test cases for recording and replaying input logs."""
+import os
+import shutil
+import tempfile
+from functools import partial
+from unittest import TestCase
+import numpy as np
+from ..nes_env import NESEnv
+from ..input_log import InputLog, replay, replay_parallel
+
+
+# the path to the Super Mario Bros. ROM for the tests
+PATH = os.path.join(os.path.dirname(__file__), 'games/smb1.nes')
+
+
+def record(path, frames):
+    """Record an input log of random play and return the screens."""
+    env = NESEnv(PATH)
+    env._record(keyframe_interval=50)
+    env.reset()
+    screens = []
+    for frame in range(frames):
+        # press start early on to get into the game
+        action = 8 if frame < 10 else env.action_space.sample()
+        state, _, _, _ = env.step(action)
+        screens.append(state.copy())
+    env._stop_recording(path)
+    env.close()
+    return screens
+
+
+def final_screen(env, log):
+    """Replay a log and return the final screen (for replay_parallel)."""
+    for _, screen in replay(env, log):
+        pass
+    return screen.copy()
+
+
+class ShouldRaiseValueErrorOnInvalidLog(TestCase):
+    def test(self):
+        self.assertRaises(ValueError, InputLog, PATH)
+
+
+class ShouldReplayInputLog(TestCase):
+    def setUp(self):
+        self.directory = tempfile.mkdtemp()
+        self.path = os.path.join(self.directory, 'smb1.log')
+        self.screens = record(self.path, 300)
+
+    def tearDown(self):
+        shutil.rmtree(self.directory)
+
+    def test_replay(self):
+        env = NESEnv(PATH)
+        log = InputLog(self.path)
+        self.assertEqual(300, log.frames)
+        for frame, screen in replay(env, log):
+            self.assertTrue(np.array_equal(self.screens[frame - 1], screen))
+        log.close()
+        env.close()
+
+    def test_seek(self):
+        env = NESEnv(PATH)
+        log = InputLog(self.path)
+        for frame in [299, 17, 151, 152, 100, 1, 300]:
+            env._seek(log, frame)
+            self.assertTrue(np.array_equal(self.screens[frame - 1], env.screen))
+        self.assertRaises(ValueError, env._seek, log, 301)
+        log.close()
+        env.close()
+
+    def test_seek_other_rom(self):
+        # the log can't be replayed in another game
+        with open(self.path, 'r+b') as log:
+            log.seek(12)
+            log.write(b'\0' * 8)
+        env = NESEnv(PATH)
+        log = InputLog(self.path)
+        self.assertRaises(ValueError, env._seek, log, 1)
+        log.close()
+        env.close()
+
+    def test_replay_parallel(self):
+        env_fn = partial(NESEnv, PATH)
+        screens = replay_parallel(env_fn, [self.path] * 2, final_screen, 2)
+        for screen in screens:
+            self.assertTrue(np.array_equal(self.screens[-1], screen))
@@ -132,3 +132,472 @@ class ShouldStepEnvBackupRestore(TestCase):
         env._restore()
         self.assertTrue(np.array_equal(backup, env.screen))
         env.close()
+
+
+class ShouldReuseBackupStorage(TestCase):
+    def test(self):
+        import numpy as np
+        env = create_smb1_instance()
+        env.reset()
+        env._backup()
+        for _ in range(100):
+            env.step(8)
+        # a later backup overwrites the earlier one in place
+        env._backup()
+        screen = env.screen.copy()
+        ram = [env._read_mem(a) for a in range(0x800)]
+        for _ in range(2):
+            for _ in range(50):
+                env.step(0)
+            env._restore()
+            self.assertTrue(np.array_equal(screen, env.screen))
+            self.assertEqual(ram, [env._read_mem(a) for a in range(0x800)])
+        env.close()
+
+
+class ShouldStepEnvAsync(TestCase):
+    def test(self):
+        import numpy as np
+        env = create_smb1_instance()
+        expected = create_smb1_instance()
+        env.reset()
+        expected.reset()
+        previous = None
+        for step in range(250):
+            action = 8 if step < 10 else step % 256
+            env.step_async(action)
+            # the previous observation should stay valid while stepping
+            if previous is not None:
+                self.assertTrue(np.array_equal(previous_copy, previous))
+            state, reward, done, info = env.step_wait()
+            expected_state, _, _, _ = expected.step(action)
+            self.assertTrue(np.array_equal(expected_state, state))
+            self.assertIsInstance(done, bool)
+            self.assertIsInstance(info, dict)
+            previous = state
+            previous_copy = state.copy()
+        env.close()
+        expected.close()
+
+
+class ShouldStepEnvAsyncWithFrameSkip(TestCase):
+    def test(self):
+        import os
+        import numpy as np
+        from ..nes_env import NESEnv
+
+        class FrameCounterEnv(NESEnv):
+            """An environment rewarding the change of the frame counter each frame."""
+
+            def _did_reset(self):
+                self.counter = self._read_mem(0x09)
+
+            def _get_reward(self):
+                before = self.counter
+                self.counter = self._read_mem(0x09)
+                return self.counter - before
+
+            def _get_done(self):
+                return self.counter == 0
+
+            def _get_info(self):
+                return {'frame': self.counter}
+
+        path = os.path.join(os.path.dirname(__file__), 'games/smb1.nes')
+        counter = [(0x09, 1, 'little', 1)]
+        # the callbacks run between the frames of the step in Python, the
+        # frames run natively without callbacks, or the native specification
+        # replaces the callbacks
+        plain = NESEnv(path, frames_per_step=4)
+        callbacks = FrameCounterEnv(path, frames_per_step=4)
+        native = NESEnv(path, frames_per_step=4)
+        native._set_step_spec(counter, [[(0x09, '==', 0)]], {'frame': counter})
+        expected = FrameCounterEnv(path, frames_per_step=4)
+        envs = [plain, callbacks, native]
+        for env in envs:
+            self.assertTrue(np.array_equal(expected.reset(), env.reset()))
+        episodes = 0
+        for step in range(150):
+            action = 8 if step % 50 < 3 else step % 256
+            for env in envs:
+                env.step_async(action)
+            outputs = [env.step_wait() for env in envs]
+            state, reward, done, info = expected.step(action)
+            # without a done predicate, the plain step runs all its frames
+            if not done:
+                self.assertTrue(np.array_equal(state, outputs[0][0]), step)
+            for output in outputs[1:]:
+                self.assertTrue(np.array_equal(state, output[0]), step)
+                self.assertEqual(reward, output[1], step)
+                self.assertEqual(done, output[2], step)
+                self.assertEqual(info, output[3], step)
+            if done:
+                episodes += 1
+                for env in envs + [expected]:
+                    env.reset()
+        self.assertGreater(episodes, 0)
+        for env in envs + [expected]:
+            env.close()
+
+
+class ShouldCountHardwareEvents(TestCase):
+    def test(self):
+        from ..nes_env import counters_enabled
+        env = create_smb1_instance()
+        if not counters_enabled():
+            self.assertIsNone(env.unwrapped._counters())
+            env.close()
+            self.skipTest('compiled without NES_COUNTERS')
+        env.reset()
+        for _ in range(10):
+            env.step(0)
+        counters = env.unwrapped._counters(reset=True)
+        self.assertGreater(counters['instructions'], 0)
+        self.assertGreater(counters['cycles'], counters['instructions'])
+        self.assertGreater(counters['nmis'], 0)
+        self.assertEqual(0, env.unwrapped._counters()['instructions'])
+        env.close()
+
+
+class ShouldProfileGuestCode(TestCase):
+    def test(self):
+        import os
+        import tempfile
+        env = create_smb1_instance()
+        env.reset()
+        env.unwrapped._profile(interval=7)
+        for _ in range(10):
+            env.step(0)
+        path = os.path.join(tempfile.mkdtemp(), 'profile.txt')
+        env.unwrapped._stop_profile(path)
+        with open(path) as profile:
+            lines = profile.read().splitlines()
+        os.remove(path)
+        self.assertIn('# opcodes', lines)
+        # SMB idles in a JMP loop in the first PRG-ROM bank
+        opcodes = lines.index('# opcodes')
+        self.assertTrue(lines[opcodes + 2].startswith('4C '))
+        env.close()
+
+
+class ShouldRecordLatencyAndTrace(TestCase):
+    def test(self):
+        import json
+        import os
+        import tempfile
+        from ..nes_env import start_trace, stop_trace
+        env = create_smb1_instance()
+        env.reset()
+        env.unwrapped._reset_latency()
+        start_trace()
+        for _ in range(10):
+            env.step(0)
+        env.unwrapped._backup()
+        env.unwrapped._restore()
+        path = os.path.join(tempfile.mkdtemp(), 'trace.json')
+        stop_trace(path)
+        latency = env.unwrapped._latency()
+        self.assertEqual(10, latency['step']['count'])
+        self.assertEqual(1, latency['backup']['count'])
+        self.assertEqual(1, latency['restore']['count'])
+        self.assertLessEqual(latency['step']['p50'], latency['step']['max'])
+        with open(path) as trace:
+            events = json.load(trace)['traceEvents']
+        os.remove(path)
+        names = [event['name'] for event in events if event['ph'] == 'X']
+        self.assertEqual(10, names.count('step'))
+        env.close()
+
+
+class ShouldRenderPixelFormats(TestCase):
+    def test(self):
+        env = create_smb1_instance()
+        env.reset()
+        for _ in range(40):
+            env.step(0)
+        env.unwrapped._backup()
+        screens = {}
+        for pixel_format in ['rgb', 'gray', 'index']:
+            env.unwrapped._restore()
+            env.unwrapped._set_pixel_format(pixel_format)
+            for _ in range(2):
+                env.step(0)
+            screens[pixel_format] = env.screen.copy()
+        # gray and index pixels repeat one value in each channel
+        for pixel_format in ['gray', 'index']:
+            screen = screens[pixel_format]
+            self.assertTrue((screen[..., 0] == screen[..., 1]).all())
+            self.assertTrue((screen[..., 0] == screen[..., 2]).all())
+        self.assertLess(screens['index'].max(), 64)
+        # each NES color has exactly one RGB color
+        rgb = screens['rgb'].reshape(-1, 3)
+        index = screens['index'][..., 0].reshape(-1)
+        for color in set(index.tolist()):
+            self.assertEqual(1, len(set(map(tuple, rgb[index == color]))))
+        self.assertRaises(ValueError, env.unwrapped._set_pixel_format, 'cmyk')
+        env.close()
+
+
+class ShouldObserveTilesAndSprites(TestCase):
+    def test(self):
+        from ..wrappers import SymbolicObservationEnv
+        rendered = create_smb1_instance()
+        rendered.reset()
+        env = SymbolicObservationEnv(create_smb1_instance())
+        observation = env.reset()
+        for _ in range(40):
+            rendered.step(0)
+            observation, _, _, _ = env.step(0)
+        self.assertEqual((30, 32), observation['tiles'].shape)
+        self.assertEqual((64, 4), observation['sprites'].shape)
+        self.assertLessEqual(observation['palettes'].max(), 3)
+        # the title screen has a background
+        self.assertGreater(len(set(observation['tiles'].ravel().tolist())), 1)
+        # disabling rendering doesn't change the emulation
+        expected = rendered.unwrapped._observe()
+        for key, value in expected.items():
+            self.assertTrue((value == observation[key]).all())
+        rendered.close()
+        env.close()
+
+
+class ShouldRunUntilRAMPredicate(TestCase):
+    def test(self):
+        env = create_smb1_instance()
+        env.reset()
+        for _ in range(40):
+            env.step(0)
+        env.unwrapped._backup()
+        # SMB increments its frame counter at $09 each frame
+        counter = env.unwrapped._read_mem(0x09)
+        target = (counter + 5) % 256
+        frames, clause = env.unwrapped._run_until(0, [
+            [(0x09, '==', 0xFF), (0x09, '==', 0x00)],
+            [(0x09, '==', target)],
+        ], max_frames=100)
+        self.assertEqual((5, 1), (frames, clause))
+        # a predicate that already holds runs no frames
+        self.assertEqual((0, 0), env.unwrapped._run_until(0, [[(0x09, '>=', 0)]], 100))
+        # the frame budget stops predicates that don't hold
+        env.unwrapped._restore()
+        frames, clause = env.unwrapped._run_until(0, [[(0x09, '<', 0, 0x01)]], 10)
+        self.assertEqual((10, None), (frames, clause))
+        # testing each instruction finds the frame the counter changes in
+        env.unwrapped._restore()
+        frames, clause = env.unwrapped._run_until(0, [[(0x09, 'changed', 0)]], 10, True)
+        self.assertEqual((1, 0), (frames, clause))
+        self.assertEqual((counter + 1) % 256, env.unwrapped._read_mem(0x09))
+        self.assertRaises(ValueError, env.unwrapped._run_until, 0, [[(0, '=', 0)]], 1)
+        # clauses past 255 keep their index
+        clauses = [[(0x09, '<', 0, 0x01)]] * 300 + [[(0x09, '>=', 0)]]
+        self.assertEqual((0, 300), env.unwrapped._run_until(0, clauses, 10))
+        self.assertRaises(ValueError, env.unwrapped._run_until, 0,
+            [[(0x09, '>=', 0)]] * 0x10001, 1)
+        env.close()
+
+
+class ShouldWatchMemoryWrites(TestCase):
+    def test(self):
+        env = create_smb1_instance()
+        env.reset()
+        for _ in range(40):
+            env.step(0)
+        events, dropped = env.unwrapped._drain_watch_events()
+        self.assertEqual((0, 0), (len(events), dropped))
+        # the frame counter of SMB is written once a frame (through a mirror)
+        env.unwrapped._watch([0x0809])
+        counter = env.unwrapped._read_mem(0x09)
+        for _ in range(3):
+            env.step(0)
+        events, dropped = env.unwrapped._drain_watch_events()
+        self.assertEqual(0, dropped)
+        self.assertEqual([0, 1, 2], events['frame'].tolist())
+        self.assertTrue((events['address'] == 0x09).all())
+        self.assertEqual(counter, events['old_value'][0])
+        self.assertEqual((counter + 3) % 256, events['value'][-1])
+        env.unwrapped._watch([0x09], enabled=False)
+        env.step(0)
+        self.assertEqual(0, len(env.unwrapped._drain_watch_events()[0]))
+        # PRG-RAM can be watched (SMB never writes it)
+        env.unwrapped._watch([0x6000])
+        env.step(0)
+        self.assertEqual(0, len(env.unwrapped._drain_watch_events()[0]))
+        # PPU / APU registers and mapper registers can't be watched
+        for address in (0x2000, 0x4018, 0x5FFF, 0x8000, 0xFFFF):
+            self.assertRaises(ValueError, env.unwrapped._watch, [address])
+        env.close()
+
+
+class ShouldRolloutActionSequences(TestCase):
+    def test(self):
+        import numpy as np
+        env = create_smb1_instance()
+        env.reset()
+        # press start on the title screen and wait for the level to load
+        for frame in range(180):
+            env.step(8 if 60 <= frame < 65 else 0)
+        env.unwrapped._backup()
+        before = [env.unwrapped._read_mem(a) for a in range(0x800)]
+        # hold right and jump every few frames, or stand still
+        actions = np.zeros((4, 60), dtype=np.uint8)
+        actions[0] = 0x80
+        actions[1, ::8] = 0x81
+        actions[2] = 0x82
+        reward = [(0x006D, 1, 'little', 256), (0x0086, 1, 'little', 1)]
+        results = [
+            env.unwrapped._rollout(actions, reward=reward, workers=workers)
+            for workers in [1, 3]
+        ]
+        # the environment is left where the rollouts started
+        after = [env.unwrapped._read_mem(a) for a in range(0x800)]
+        self.assertEqual(before, after)
+        for rewards, frames, final_ram in results:
+            self.assertEqual([60] * 4, frames.tolist())
+            self.assertEqual(results[0][0].tolist(), rewards.tolist())
+            self.assertTrue((results[0][2] == final_ram).all())
+        rewards, _, final_ram = results[0]
+        # the rollouts match stepping the actions
+        for k in range(4):
+            env.unwrapped._restore()
+            for action in actions[k]:
+                env.step(int(action))
+            ram = [env.unwrapped._read_mem(a) for a in range(0x800)]
+            self.assertEqual(ram, final_ram[k].tolist())
+        # running right goes farther than standing still
+        self.assertGreater(rewards[0], rewards[3])
+        # a done predicate ends the rollouts early
+        env.unwrapped._restore()
+        _, frames, _ = env.unwrapped._rollout(actions,
+            done=[[(0x09, 'changed', 0)]], workers=2)
+        self.assertEqual([1] * 4, frames.tolist())
+        # the values of reward terms are 1 to 8 bytes long
+        for size in [0, 9]:
+            self.assertRaises(ValueError, env.unwrapped._rollout, actions,
+                reward=[(0x07DD, size, 'digits', 1)])
+        env.close()
+
+
+class ShouldCloneAndBroadcastState(TestCase):
+    def test(self):
+        env = create_smb1_instance()
+        env.reset()
+        for frame in range(180):
+            env.step(8 if 60 <= frame < 65 else 0)
+        ram = [env._read_mem(a) for a in range(0x800)]
+        clone = env.clone()
+        self.assertIsInstance(clone, type(env))
+        self.assertEqual(ram, [clone._read_mem(a) for a in range(0x800)])
+        self.assertTrue((env.screen == clone.screen).all())
+        # the clone is independent and runs the same as its source
+        others = [create_smb1_instance() for _ in range(2)]
+        env.broadcast(others)
+        screens = []
+        for target in [env, clone] + others:
+            screens.append([target.step(0x81)[0].copy() for _ in range(30)])
+        for target_screens in screens[1:]:
+            for screen, expected in zip(target_screens, screens[0]):
+                self.assertTrue((screen == expected).all())
+        ram = [env._read_mem(a) for a in range(0x800)]
+        for target in [clone] + others:
+            self.assertEqual(ram, [target._read_mem(a) for a in range(0x800)])
+        # closing the source leaves the shared ROM with the clone
+        env.close()
+        clone.step(0)
+        clone.close()
+        for target in others:
+            target.close()
+
+
+class ShouldResetToGoldenState(TestCase):
+    def test(self):
+        env = create_smb1_instance()
+        env.reset()
+        self.assertFalse(env._has_reset_state)
+        for frame in range(180):
+            env.step(8 if 60 <= frame < 65 else 0)
+        ram = [env._read_mem(a) for a in range(0x800)]
+        screen = env.screen.copy()
+        env._set_reset_state()
+        for _ in range(30):
+            env.step(0x81)
+        # resets of any environment of the ROM load the golden state
+        other = create_smb1_instance()
+        try:
+            for target in [env, other]:
+                self.assertTrue(target._has_reset_state)
+                self.assertTrue((screen == target.reset()).all())
+                self.assertEqual(ram, [target._read_mem(a) for a in range(0x800)])
+            screens = [[t.step(0x81)[0].copy() for _ in range(10)] for t in [env, other]]
+            for a, b in zip(*screens):
+                self.assertTrue((a == b).all())
+        finally:
+            env._clear_reset_state()
+        self.assertFalse(other._has_reset_state)
+        other.reset()
+        self.assertNotEqual(ram, [other._read_mem(a) for a in range(0x800)])
+        env.close()
+        other.close()
+
+
+class ShouldReadRAMOfBatch(TestCase):
+    def test(self):
+        import numpy as np
+        from ..nes_env import ram_values, read_ram, PRG_RAM_SIZE
+        envs = [create_smb1_instance() for _ in range(3)]
+        for index, env in enumerate(envs):
+            env.reset()
+            for step in range(100 + 50 * index):
+                env.step(8 if step % 40 < 5 else 0)
+        prg_ram = np.empty((len(envs), PRG_RAM_SIZE), dtype=np.uint8)
+        ram = read_ram(envs, prg_ram=prg_ram)
+        self.assertEqual((3, 0x800), ram.shape)
+        for index, env in enumerate(envs):
+            expected = [env._read_mem(a) for a in range(0x800)]
+            self.assertEqual(expected, ram[index].tolist())
+        # Super Mario Bros. doesn't use its PRG RAM
+        self.assertFalse(prg_ram.any())
+        self.assertRaises(ValueError, read_ram, envs, ram[:2])
+        # the vectorized values match the native rewards
+        for terms in ([(0x07DD, 6, 'digits', 10)], [(0x006D, 2, 'big', 0.1)],
+                      [(0x0086, 2, 'little', 1), (0x075A, 1, 'little', -2)]):
+            values = ram_values(ram, terms)
+            for index, env in enumerate(envs):
+                actions = np.full((1, 60), 0x81, dtype=np.uint8)
+                rewards, _, final = env._rollout(actions, terms)
+                change = ram_values(final, terms)[0] - values[index]
+                self.assertAlmostEqual(rewards[0], change)
+        score = ram_values(ram, [(0x07DD, 6, 'digits', 1)])
+        for index, env in enumerate(envs):
+            digits = [env._read_mem(a) % 10 for a in range(0x07DD, 0x07E3)]
+            self.assertEqual(int(''.join(map(str, digits))), score[index])
+        self.assertRaises(ValueError, ram_values, ram, [(0, 1, 'bits', 1)])
+        self.assertRaises(ValueError, ram_values, ram, [(0, 0, 'little', 1)])
+        self.assertRaises(ValueError, ram_values, ram, [(0, 9, 'little', 1)])
+        for env in envs:
+            env.close()
+
+
+class ShouldReportMemoryFootprint(TestCase):
+    def test(self):
+        env = create_smb1_instance()
+        env.reset()
+        for _ in range(10):
+            env.step(0)
+        footprint = env._memory_footprint()
+        self.assertEqual(0, footprint['backup'])
+        # the game-state and its snapshots exclude the framebuffer
+        self.assertLess(footprint['state'], 64 * 1024)
+        self.assertLess(footprint['serialized'], 16 * 1024)
+        self.assertGreaterEqual(footprint['framebuffer'], 2 * 256 * 240 * 4)
+        self.assertGreater(footprint['shared'], 40 * 1024)
+        env._backup()
+        backup = env._memory_footprint()['backup']
+        self.assertGreater(backup, footprint['state'])
+        # clones share the ROM
+        clone = env.clone()
+        self.assertEqual(footprint['shared'], clone._memory_footprint()['shared'])
+        # measuring doesn't depend on which environment is on the machine
+        clone.step(0)
+        self.assertEqual(footprint['serialized'], env._memory_footprint()['serialized'])
+        clone.close()
+        env.close()
@@ -0,0 +1,111 @@
+"""Test cases for save-state files."""
+import os
+import shutil
+import tempfile
+from unittest import TestCase
+from ..nes_env import NESEnv
+from ..save_state import SaveState
+
+
+# the path to the Super Mario Bros. ROM for the tests
+PATH = os.path.join(os.path.dirname(__file__), 'games/smb1.nes')
+
+
+class ShouldRaiseValueErrorOnInvalidSaveState(TestCase):
+    def test(self):
+        self.assertRaises(ValueError, SaveState, PATH)
+
+
+class ShouldSaveAndLoadState(TestCase):
+    def setUp(self):
+        self.directory = tempfile.mkdtemp()
+        self.path = os.path.join(self.directory, 'smb1.state')
+
+    def tearDown(self):
+        shutil.rmtree(self.directory)
+
+    def test(self):
+        env = NESEnv(PATH)
+        env.reset()
+        for frame in range(120):
+            env.step(8 if frame < 10 else 0)
+        env._save_state(self.path)
+        expected = [env.step(0x80)[0].copy() for _ in range(10)]
+        ram = [env._read_mem(address) for address in range(0x800)]
+        env.close()
+        # a new environment continues exactly from the state
+        env = NESEnv(PATH)
+        env.reset()
+        with SaveState(self.path) as state:
+            for _ in range(2):
+                env._load_state(state)
+                screens = [env.step(0x80)[0].copy() for _ in range(10)]
+                # the first screen is drawn partly before the state (the
+                # video buffer isn't saved)
+                for actual, screen in zip(screens[1:], expected[1:]):
+                    self.assertTrue((actual == screen).all())
+                self.assertEqual(ram, [env._read_mem(a) for a in range(0x800)])
+        env.close()
+        # the state can't be loaded into another game
+        with open(self.path, 'r+b') as state:
+            state.seek(8)
+            state.write(b'\0' * 8)
+        env = NESEnv(PATH)
+        self.assertRaises(ValueError, env._load_state, self.path)
+        env.close()
+
+
+class ShouldRejectTruncatedResetState(TestCase):
+    def setUp(self):
+        self.directory = tempfile.mkdtemp()
+        self.path = os.path.join(self.directory, 'smb1.state')
+
+    def tearDown(self):
+        shutil.rmtree(self.directory)
+
+    def test(self):
+        import struct
+        env = NESEnv(PATH)
+        env.reset()
+        env._save_state(self.path)
+        # cut the state in half (keeping the header consistent)
+        with open(self.path, 'r+b') as state:
+            size = struct.unpack('<Q', state.read(24)[16:])[0] // 2
+            state.seek(16)
+            state.write(struct.pack('<Q', size))
+            state.truncate(24 + size)
+        ram = [env._read_mem(a) for a in range(0x800)]
+        self.assertRaises(ValueError, env._set_reset_state, self.path)
+        self.assertFalse(env._has_reset_state)
+        # checking the state leaves the machine as it was
+        self.assertEqual(ram, [env._read_mem(a) for a in range(0x800)])
+        env.close()
+
+
+class ShouldRejectTruncatedSaveState(TestCase):
+    def setUp(self):
+        self.directory = tempfile.mkdtemp()
+        self.path = os.path.join(self.directory, 'smb1.state')
+
+    def tearDown(self):
+        shutil.rmtree(self.directory)
+
+    def test(self):
+        import struct
+        env = NESEnv(PATH)
+        env.reset()
+        env._save_state(self.path)
+        # cut off the last byte of the state (keeping the header consistent)
+        with open(self.path, 'r+b') as state:
+            size = struct.unpack('<Q', state.read(24)[16:])[0] - 1
+            state.seek(16)
+            state.write(struct.pack('<Q', size))
+            state.truncate(24 + size)
+        for _ in range(30):
+            env.step(0)
+        ram = [env._read_mem(a) for a in range(0x800)]
+        self.assertRaises(ValueError, env._load_state, self.path)
+        # the failed load leaves the machine as it was
+        self.assertEqual(ram, [env._read_mem(a) for a in range(0x800)])
+        env.step(0)
+        env.close()
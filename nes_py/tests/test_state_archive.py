@@ -0,0 +1,69 @@
+"""Test cases for state archives."""
+import os
+import shutil
+import tempfile
+from unittest import TestCase
+import numpy as np
+from ..nes_env import NESEnv
+from ..state_archive import StateArchive
+
+
+# the path to the Super Mario Bros. ROM for the tests
+PATH = os.path.join(os.path.dirname(__file__), 'games/smb1.nes')
+
+
+def ram(env):
+    """Return the RAM of an environment."""
+    return [env._read_mem(address) for address in range(0x800)]
+
+
+class ShouldArchiveAndRestoreStates(TestCase):
+    def setUp(self):
+        self.directory = tempfile.mkdtemp()
+        self.path = os.path.join(self.directory, 'cells.archive')
+
+    def tearDown(self):
+        shutil.rmtree(self.directory)
+
+    def test(self):
+        envs = [NESEnv(PATH) for _ in range(3)]
+        for index, env in enumerate(envs):
+            env.reset()
+            for _ in range(40 + 10 * index):
+                env.step(0)
+        expected = [ram(env) for env in envs]
+        with StateArchive(self.path, envs[0]) as archive:
+            metadata = np.arange(6, dtype=np.uint8).reshape(3, 2)
+            keys, added = archive.add(envs, metadata=metadata)
+            self.assertTrue(added.all())
+            # equal states have equal keys
+            self.assertEqual(3, len(set(keys.tolist())))
+            _, added = archive.add(envs[:1])
+            self.assertFalse(added.any())
+            self.assertEqual(3, len(archive))
+            # explicit keys and replacing a record
+            archive.add(envs[2:], keys=[7], metadata=[[9]])
+            archive.add(envs[1:2], keys=[7], metadata=[[8]], replace=True)
+            self.assertEqual(b'\x08', archive.metadata(7))
+        # the index is rebuilt when the archive is opened again
+        with open(self.path, 'ab') as archive_file:
+            # a truncated record (e.g., from a crash) is discarded
+            archive_file.write(b'\x01\x02\x03')
+        with StateArchive(self.path, envs[0]) as archive:
+            self.assertEqual(keys.tolist() + [7], archive.keys().tolist())
+            self.assertEqual(b'\x02\x03', archive.metadata(keys[1]))
+            # restore the cells in reverse order
+            archive.restore(envs, keys[::-1])
+            for env, cell in zip(envs, expected[::-1]):
+                self.assertEqual(cell, ram(env))
+            archive.restore(envs[:1], [7])
+            self.assertEqual(expected[1], ram(envs[0]))
+            self.assertRaises(KeyError, archive.restore, envs[:1], [12345])
+            self.assertRaises(KeyError, archive.metadata, 12345)
+            # appending after the truncated record keeps the archive valid
+            archive.add(envs[:1], keys=[8])
+        with StateArchive(self.path, envs[0]) as archive:
+            self.assertEqual(5, len(archive))
+            self.assertIn(8, archive)
+        for env in envs:
+            env.close()
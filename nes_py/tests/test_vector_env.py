@@ -0,0 +1,155 @@
+"""Test cases for the SharedMemoryVectorEnv class."""
+import os
+from functools import partial
+from unittest import TestCase
+import numpy as np
+from ..nes_env import NESEnv
+from ..nes_env import read_ram
+from ..vector_env import SharedMemoryVectorEnv
+
+
+# the path to the Super Mario Bros. ROM for the tests
+PATH = os.path.join(os.path.dirname(__file__), 'games/smb1.nes')
+
+
+class ShouldRaiseValueErrorOnEmptyEnvFns(TestCase):
+    def test(self):
+        self.assertRaises(ValueError, SharedMemoryVectorEnv, [])
+
+
+class ShouldRaiseValueErrorOnInvalidNumWorkers(TestCase):
+    def test(self):
+        env_fns = [partial(NESEnv, PATH)]
+        self.assertRaises(ValueError, SharedMemoryVectorEnv, env_fns, 0)
+
+
+class ShouldStepVectorEnv(TestCase):
+    def test(self):
+        env = SharedMemoryVectorEnv([partial(NESEnv, PATH)] * 4, num_workers=2)
+        obs = env.reset()
+        self.assertEqual((4, 240, 256, 3), obs.shape)
+        for _ in range(100):
+            actions = [env.action_space.sample() for _ in range(4)]
+            obs, rewards, dones, infos = env.step(actions)
+            self.assertEqual((4, 240, 256, 3), obs.shape)
+            self.assertEqual((4, ), rewards.shape)
+            self.assertEqual((4, ), dones.shape)
+            self.assertEqual(4, len(infos))
+        env.close()
+        # trying to close again should raise an error
+        self.assertRaises(ValueError, env.close)
+
+
+class ShouldRaiseRuntimeErrorOnDeadWorker(TestCase):
+    def test(self):
+        import signal
+        env = SharedMemoryVectorEnv([partial(NESEnv, PATH)] * 2, num_workers=2)
+        env.reset()
+        # a killed worker never completes its command
+        os.kill(env._procs[1].pid, signal.SIGKILL)
+        env._procs[1].join()
+        self.assertRaises(RuntimeError, env.step, [0, 0])
+        env.close()
+
+
+class ShouldMatchSerialEnvs(TestCase):
+    def test(self):
+        num_envs = 3
+        env = SharedMemoryVectorEnv([partial(NESEnv, PATH)] * num_envs, num_workers=2)
+        serial = [NESEnv(PATH) for _ in range(num_envs)]
+        obs = env.reset()
+        for idx in range(num_envs):
+            self.assertTrue(np.array_equal(serial[idx].reset(), obs[idx]))
+        for step in range(300):
+            # press start early on to get into the game
+            actions = [8 if step < 10 else (step + idx) % 256 for idx in range(num_envs)]
+            obs, _, _, _ = env.step(actions)
+            for idx in range(num_envs):
+                state, _, _, _ = serial[idx].step(actions[idx])
+                self.assertTrue(np.array_equal(state, obs[idx]), (step, idx))
+            self.assertTrue(np.array_equal(read_ram(serial), env.ram), step)
+        env.close()
+        for serial_env in serial:
+            serial_env.close()
+
+
+class ShouldAutoResetNatively(TestCase):
+    def test(self):
+        num_envs = 3
+        # episodes end when the frame counter wraps around
+        counter = [(0x09, 1, 'little', 1)]
+        env = SharedMemoryVectorEnv([partial(NESEnv, PATH)] * num_envs,
+            num_workers=2, reward=counter, done=[[(0x09, '==', 0)]],
+            info={'frame': counter})
+        self.assertEqual(('frame', ), env.info_keys)
+        serial = [NESEnv(PATH) for _ in range(num_envs)]
+        obs = env.reset()
+        for idx in range(num_envs):
+            self.assertTrue(np.array_equal(serial[idx].reset(), obs[idx]))
+        episodes = 0
+        for step in range(600):
+            actions = [8 if step % 200 < 10 else (step + idx) % 256 for idx in range(num_envs)]
+            obs, rewards, dones, infos = env.step(actions)
+            for idx in range(num_envs):
+                before = serial[idx]._read_mem(0x09)
+                state, _, _, _ = serial[idx].step(actions[idx])
+                frame = serial[idx]._read_mem(0x09)
+                self.assertEqual(frame - before, rewards[idx])
+                self.assertEqual(frame, infos[idx]['frame'])
+                self.assertEqual(frame == 0, dones[idx])
+                if dones[idx]:
+                    episodes += 1
+                    terminal = infos[idx]['terminal_observation']
+                    self.assertTrue(np.array_equal(state, terminal))
+                    state = serial[idx].reset()
+                self.assertTrue(np.array_equal(state, obs[idx]), (step, idx))
+            self.assertTrue(np.array_equal(read_ram(serial), env.ram), step)
+        self.assertGreater(episodes, 0)
+        env.close()
+        for serial_env in serial:
+            serial_env.close()
+
+
+class FrameCounterEnv(NESEnv):
+    """An environment rewarding the change of the frame counter each frame."""
+
+    def _did_reset(self):
+        self.counter = self._read_mem(0x09)
+
+    def _get_reward(self):
+        before = self.counter
+        self.counter = self._read_mem(0x09)
+        return self.counter - before
+
+    def _get_done(self):
+        return self.counter == 0
+
+
+class ShouldMatchSerialStepsWithFrameSkip(TestCase):
+    def test(self):
+        num_envs = 2
+        counter = [(0x09, 1, 'little', 1)]
+        env_fn = partial(NESEnv, PATH, frames_per_step=4)
+        env = SharedMemoryVectorEnv([env_fn] * num_envs, num_workers=2,
+            reward=counter, done=[[(0x09, '==', 0)]])
+        serial = [FrameCounterEnv(PATH, frames_per_step=4) for _ in range(num_envs)]
+        obs = env.reset()
+        for idx in range(num_envs):
+            self.assertTrue(np.array_equal(serial[idx].reset(), obs[idx]))
+        episodes = 0
+        for step in range(150):
+            actions = [8 if step % 50 < 3 else (step + idx) % 256 for idx in range(num_envs)]
+            env.step_async(actions)
+            obs, rewards, dones, _ = env.step_wait()
+            for idx in range(num_envs):
+                state, reward, done, _ = serial[idx].step(actions[idx])
+                self.assertEqual(reward, rewards[idx], (step, idx))
+                self.assertEqual(done, dones[idx], (step, idx))
+                if done:
+                    episodes += 1
+                    state = serial[idx].reset()
+                self.assertTrue(np.array_equal(state, obs[idx]), (step, idx))
+        self.assertGreater(episodes, 0)
+        env.close()
+        for serial_env in serial:
+            serial_env.close()
@@ -0,0 +1,458 @@
+"""A vector of NES environments hosted by worker processes."""
+import ctypes
+import multiprocessing
+import sys
+import traceback
+import numpy as np
+from .nes_env import _LIB
+from .nes_env import _ram_conditions
+from .nes_env import _reward_terms
+from .nes_env import RAM_SIZE
+from .nes_env import read_ram
+from .nes_env import SCREEN_SHAPE_24_BIT
+from .nes_env import SCREEN_SHAPE_32_BIT
+
+
+# the command to step every environment of a worker
+_STEP = 0
+# the command to reset every environment of a worker
+_RESET = 1
+# the command to close every environment of a worker and exit
+_CLOSE = 2
+
+
+# the number of 32-bit words in a cache line. the counters written by the
+# learner and the counters written by a worker live on separate lines
+_LINE = 16
+# the sequence number of the latest command (written by the learner). the
+# word after each counter counts the processes waiting on it (sequence.hpp)
+_COMMAND = 0
+# the code of the latest command (written by the learner)
+_CODE = 2
+# the sequence number of the latest completion (written by the worker)
+_COMPLETION = _LINE
+# a flag for whether the worker has failed (written by the worker)
+_STATUS = _LINE + 2
+# the number of 32-bit words in the control block of a worker
+_CONTROL_SIZE = 2 * _LINE
+# the milliseconds between checks for dead workers while waiting on them
+_WAIT_TIMEOUT = 100
+
+
+class _SharedBuffers(object):
+    """Shared memory for the observations, RAM, rewards, dones, and actions."""
+
+    def __init__(self, num_envs, num_workers, obs_shape, obs_dtype, num_info):
+        """
+        Allocate the shared memory for a vector environment.
+
+        Args:
+            num_envs (int): the number of environments in the vector
+            num_workers (int): the number of worker processes
+            obs_shape (tuple): the shape of an observation
+            obs_dtype (np.dtype): the data type of an observation
+            num_info (int): the number of numeric info values per environment
+
+        Returns:
+            None
+
+        """
+        self.num_envs = num_envs
+        self.obs_shape = tuple(obs_shape)
+        self.obs_dtype = np.dtype(obs_dtype)
+        self.num_info = num_info
+        obs_bytes = num_envs * int(np.prod(obs_shape)) * self.obs_dtype.itemsize
+        # the raw shared memory (mapped by the learner and all workers). there
+        # are two observation buffers that alternate between commands
+        self._observations = multiprocessing.RawArray(ctypes.c_uint8, 2 * obs_bytes)
+        # the RAM of the environments (alternating like the observations)
+        self._ram = multiprocessing.RawArray(ctypes.c_uint8, 2 * num_envs * RAM_SIZE)
+        # the last observations of the episodes that ended in the latest step
+        self._terminals = multiprocessing.RawArray(ctypes.c_uint8, obs_bytes)
+        self._actions = multiprocessing.RawArray(ctypes.c_int64, num_envs)
+        self._rewards = multiprocessing.RawArray(ctypes.c_double, num_envs)
+        self._dones = multiprocessing.RawArray(ctypes.c_uint8, num_envs)
+        self._infos = multiprocessing.RawArray(ctypes.c_double, max(1, num_envs * num_info))
+        self._control = multiprocessing.RawArray(ctypes.c_uint32, num_workers * _CONTROL_SIZE)
+
+    def views(self):
+        """Return NumPy views of the shared memory (zero-copy)."""
+        observations = np.frombuffer(self._observations, dtype=self.obs_dtype)
+        observations = observations.reshape((2, self.num_envs) + self.obs_shape)
+        ram = np.frombuffer(self._ram, dtype=np.uint8)
+        ram = ram.reshape((2, self.num_envs, RAM_SIZE))
+        terminals = np.frombuffer(self._terminals, dtype=self.obs_dtype)
+        terminals = terminals.reshape((self.num_envs, ) + self.obs_shape)
+        actions = np.frombuffer(self._actions, dtype=np.int64)
+        rewards = np.frombuffer(self._rewards, dtype=np.float64)
+        dones = np.frombuffer(self._dones, dtype=np.uint8)
+        infos = np.frombuffer(self._infos, dtype=np.float64)
+        infos = infos[:self.num_envs * self.num_info]
+        infos = infos.reshape((self.num_envs, self.num_info))
+        control = np.frombuffer(self._control, dtype=np.uint32)
+        control = control.reshape((-1, _CONTROL_SIZE))
+        return observations, ram, terminals, actions, rewards, dones, infos, control
+
+    def counter(self, worker, field):
+        """
+        Return the address of a counter in the control block of a worker.
+
+        Args:
+            worker (int): the index of the worker
+            field (int): the offset of the counter in the control block
+
+        Returns:
+            the address of the 32-bit counter as an integer
+
+        """
+        offset = (worker * _CONTROL_SIZE + field) * ctypes.sizeof(ctypes.c_uint32)
+        return ctypes.addressof(self._control) + offset
+
+
+class _NativeBatch(object):
+    """The native batched step of the environments of a worker."""
+
+    def __init__(self, envs, reward, done, info):
+        """
+        Prepare the native arguments of the environments of a worker.
+
+        Args:
+            envs (list): the environments of the worker
+            reward (list): the terms of the reward (see NESEnv._rollout)
+            done (list): the clauses of a RAM predicate that ends an episode
+            info (list): the terms of each info value
+
+        Returns:
+            None
+
+        """
+        envs = [env.unwrapped for env in envs]
+        self._count = len(envs)
+        self._envs = (ctypes.c_void_p * self._count)(*[env._env for env in envs])
+        self._frames = envs[0]._frames_per_step
+        self._reward = _reward_terms(reward)
+        self._done = _ram_conditions(done)
+        self._info = _reward_terms([term for terms in info for term in terms])
+        self._info_sizes = (ctypes.c_int * len(info))(*[len(terms) for terms in info])
+        self._actions = np.empty(self._count, dtype=np.uint8)
+        shape = (self._count, ) + SCREEN_SHAPE_32_BIT
+        self._screens = np.empty(shape, dtype=np.uint8)
+        self._terminals = np.empty(shape, dtype=np.uint8)
+        self._is_little_endian = sys.byteorder == 'little'
+
+    def _rgb(self, screens):
+        """Return a view of 32-bit screens from the emulator as RGB."""
+        if self._is_little_endian:
+            screens = screens[..., ::-1]
+        return screens[..., 1:]
+
+    def step(self, actions, rewards, dones, infos, ram):
+        """
+        Step the environments and reset the episodes that end in place.
+
+        Args:
+            actions (np.ndarray): the action of each environment
+            rewards (np.ndarray): the buffer for the rewards (float64)
+            dones (np.ndarray): the buffer for the done flags (uint8)
+            infos (np.ndarray): the buffer for the info values (float64)
+            ram (np.ndarray): the (environments, RAM_SIZE) buffer for the
+                RAM after the step (uint8)
+
+        Returns:
+            a tuple of:
+            - the observation of each environment (a view of RGB screens)
+            - the last observation of the episodes that ended
+
+        """
+        self._actions[:] = actions
+        _LIB.NESEnv_step_batch(self._envs, self._count,
+            self._actions.ctypes.data, self._frames,
+            self._reward, len(self._reward), self._done, len(self._done),
+            self._info, self._info_sizes, len(self._info_sizes),
+            rewards.ctypes.data, dones.ctypes.data, infos.ctypes.data,
+            self._screens.ctypes.data, self._terminals.ctypes.data,
+            ram.ctypes.data)
+        ended = np.flatnonzero(dones)
+        return self._rgb(self._screens), self._rgb(self._terminals[ended])
+
+
+def _worker(index, env_fns, start, buffers, info_keys, native):
+    """
+    Host a chunk of environments and serve commands from the learner.
+
+    Args:
+        index (int): the index of this worker
+        env_fns (list): the callables to create the environments with
+        start (int): the index of the first environment of this worker
+        buffers (_SharedBuffers): the shared memory of the vector environment
+        info_keys (tuple): the numeric info keys to copy to shared memory
+        native (tuple): the reward, done, and info terms to step the
+            environments natively with, or None to step them in Python
+
+    Returns:
+        None
+
+    """
+    views = buffers.views()
+    observations, ram, terminals, actions, rewards, dones, infos, control = views
+    command = buffers.counter(index, _COMMAND)
+    completion = buffers.counter(index, _COMPLETION)
+    envs = [env_fn() for env_fn in env_fns]
+    batch = _NativeBatch(envs, *native) if native is not None else None
+    end = start + len(envs)
+    seq = 0
+    try:
+        while True:
+            # wait for the learner to publish the next command
+            seq = (seq + 1) & 0xFFFFFFFF
+            _LIB.Sequence_wait(command, seq, -1)
+            code = control[index, _CODE]
+            if code == _CLOSE:
+                break
+            # alternate observation buffers between commands
+            buffer = observations[seq % 2]
+            ram_buffer = ram[seq % 2, start:end]
+            if code == _STEP and batch is not None:
+                buffer[start:end], terminal = batch.step(actions[start:end],
+                    rewards[start:end], dones[start:end], infos[start:end],
+                    ram_buffer)
+                terminals[start + np.flatnonzero(dones[start:end])] = terminal
+                _LIB.Sequence_store(completion, seq)
+                continue
+            for offset, env in enumerate(envs):
+                i = start + offset
+                if code == _RESET:
+                    buffer[i] = np.asarray(env.reset())
+                    continue
+                obs, reward, done, info = env.step(int(actions[i]))
+                # reset finished episodes in the worker to save a round trip
+                if done:
+                    terminals[i] = np.asarray(obs)
+                    obs = env.reset()
+                buffer[i] = np.asarray(obs)
+                rewards[i] = reward
+                dones[i] = done
+                for k, key in enumerate(info_keys):
+                    infos[i, k] = info.get(key, np.nan)
+            read_ram(envs, ram_buffer)
+            # signal the learner that the command has completed
+            _LIB.Sequence_store(completion, seq)
+    except Exception:
+        traceback.print_exc()
+        control[index, _STATUS] = 1
+    finally:
+        for env in envs:
+            env.close()
+        _LIB.Sequence_store(completion, seq)
+
+
+class SharedMemoryVectorEnv(object):
+    """A vector of environments stepped by worker processes."""
+
+    def __init__(self, env_fns, num_workers=None, info_keys=(),
+        reward=(), done=None, info=None
+    ):
+        """
+        Create a new vector environment.
+
+        Workers step their environments in Python and reset the episodes
+        that end. With a native `done` predicate, workers instead step all
+        their environments and reset the episodes that end in a single
+        native call. The reward, done flag, and info values then come from
+        RAM, and the Python callbacks of the environments (e.g.,
+        `_get_reward`, `_did_step`, and `_did_reset`) don't run. Episodes
+        reset from the golden reset state of the ROM if it has one (see
+        `NESEnv._set_reset_state`).
+
+        Args:
+            env_fns (list): callables that each return a new environment
+            num_workers (int): the number of worker processes to host the
+                environments. defaults to the number of CPUs
+            info_keys (tuple): the keys of numeric values in the info
+                dictionaries to return from step
+            reward (list): the terms of the native reward (see
+                `NESEnv._rollout`)
+            done (list): the clauses of a RAM predicate (see
+                `NESEnv._run_until`) that ends an episode, tested after each
+                frame. None steps the environments in Python
+            info (dict): the terms of each native info value by its key
+                (replaces info_keys)
+
+        Returns:
+            None
+
+        """
+        if not len(env_fns):
+            raise ValueError('env_fns should contain at least one callable')
+        if num_workers is None:
+            num_workers = multiprocessing.cpu_count()
+        if not isinstance(num_workers, int):
+            raise TypeError('num_workers must be of type: int')
+        if not num_workers > 0:
+            raise ValueError('num_workers must be > 0')
+        self.num_envs = len(env_fns)
+        self.num_workers = min(num_workers, self.num_envs)
+        native = None
+        if done is not None:
+            if len(info_keys):
+                raise ValueError('info_keys should be info to step natively')
+            info = dict(info or {})
+            info_keys = tuple(info)
+            native = (list(reward), list(done), [info[key] for key in info_keys])
+        self.info_keys = tuple(info_keys)
+        # create a probe environment to determine the spaces
+        env = env_fns[0]()
+        self.observation_space = env.observation_space
+        self.action_space = env.action_space
+        env.close()
+        if native is not None and self.observation_space.shape != SCREEN_SHAPE_24_BIT:
+            raise ValueError('native steps need observations of the full screen')
+        # allocate the shared memory for the workers
+        self._buffers = _SharedBuffers(
+            self.num_envs,
+            self.num_workers,
+            self.observation_space.shape,
+            self.observation_space.dtype,
+            len(self.info_keys),
+        )
+        views = self._buffers.views()
+        self._observations, self._ram, self._terminals, self._actions = views[:4]
+        self._rewards, self._dones, self._infos, self._control = views[4:]
+        # start the workers, each hosting a contiguous chunk of environments
+        self._seq = 0
+        self._procs = []
+        chunks = np.array_split(np.arange(self.num_envs), self.num_workers)
+        for index, chunk in enumerate(chunks):
+            start = int(chunk[0])
+            fns = env_fns[start:start + len(chunk)]
+            args = (index, fns, start, self._buffers, self.info_keys, native)
+            proc = multiprocessing.Process(target=_worker, args=args)
+            proc.daemon = True
+            proc.start()
+            self._procs.append(proc)
+
+    def _post(self, code):
+        """
+        Publish a command to all the workers.
+
+        Args:
+            code (int): the code of the command to publish
+
+        Returns:
+            None
+
+        """
+        self._seq = (self._seq + 1) & 0xFFFFFFFF
+        for index in range(self.num_workers):
+            self._control[index, _CODE] = code
+            _LIB.Sequence_store(self._buffers.counter(index, _COMMAND), self._seq)
+
+    def _wait(self):
+        """Block until all the workers complete the latest command."""
+        for index in range(self.num_workers):
+            completion = self._buffers.counter(index, _COMPLETION)
+            # wake up periodically to notice workers that died without
+            # completing (e.g., crashed or killed) and keyboard interrupts
+            while not _LIB.Sequence_wait(completion, self._seq, _WAIT_TIMEOUT):
+                alive = self._procs[index].is_alive()
+                if not alive and not _LIB.Sequence_wait(completion, self._seq, 0):
+                    raise RuntimeError('worker {} died'.format(index))
+            if self._control[index, _STATUS]:
+                raise RuntimeError('worker {} failed'.format(index))
+
+    @property
+    def ram(self):
+        """
+        Return the RAM of the environments after the latest step or reset.
+
+        Returns:
+            a (num_envs, RAM_SIZE) uint8 view of the RAM in shared memory
+            (zero-copy) that stays valid until the next step is waited on.
+            the RAM of finished environments is of the next episode. use
+            `nes_py.nes_env.ram_values` to extract features from it
+
+        """
+        return self._ram[self._seq % 2]
+
+    def reset(self):
+        """
+        Reset all the environments.
+
+        Returns:
+            a view of the observations in shared memory. the view stays
+            valid until the next step is waited on
+
+        """
+        self._post(_RESET)
+        self._wait()
+        return self._observations[self._seq % 2]
+
+    def step_async(self, actions):
+        """
+        Start stepping all the environments and return immediately.
+
+        The observations from the previous step stay valid until
+        `step_wait` returns because the workers write to the other buffer.
+
+        Args:
+            actions (iterable): an action for each environment
+
+        Returns:
+            None
+
+        """
+        self._actions[:] = actions
+        self._post(_STEP)
+
+    def step_wait(self):
+        """
+        Wait for the step started by `step_async` and return its output.
+
+        Returns:
+            a tuple of:
+            - observations (np.ndarray): a view of the observations in
+              shared memory that stays valid until the next step is
+              waited on. finished environments are reset and return
+              their first observation
+            - rewards (np.ndarray): the reward for each environment
+            - dones (np.ndarray): the done flag for each environment
+            - infos (list): a dictionary of the info keys for each
+              environment (at the end of the episode if it ended). the
+              dictionaries of finished environments have the last
+              observation of the episode as 'terminal_observation'
+
+        """
+        self._wait()
+        infos = [dict(zip(self.info_keys, row)) for row in self._infos]
+        dones = self._dones.astype(bool)
+        for index in np.flatnonzero(dones):
+            infos[index]['terminal_observation'] = self._terminals[index].copy()
+        observations = self._observations[self._seq % 2]
+        return observations, self._rewards.copy(), dones, infos
+
+    def step(self, actions):
+        """
+        Step all the environments with a vector of actions.
+
+        Args:
+            actions (iterable): an action for each environment
+
+        Returns:
+            the output of `step_wait`
+
+        """
+        self.step_async(actions)
+        return self.step_wait()
+
+    def close(self):
+        """Close the environments and join the worker processes."""
+        if self._procs is None:
+            raise ValueError('env has already been closed.')
+        self._post(_CLOSE)
+        for proc in self._procs:
+            proc.join()
+        self._procs = None
+
+
+# explicitly define the outward facing API of this module
+__all__ = [SharedMemoryVectorEnv.__name__]
@@ -7,6 +7,7 @@ from .frame_stack_env import FrameStackEnv
 from .normalize_reward_env import NormalizeRewardEnv
 from .penalize_death_env import PenalizeDeathEnv
 from .reward_cache_env import RewardCacheEnv
+from .symbolic_observation_env import SymbolicObservationEnv
 
 
 def wrap(env,
@@ -64,5 +65,6 @@ __all__ = [
     NormalizeRewardEnv.__name__,
     PenalizeDeathEnv.__name__,
     RewardCacheEnv.__name__,
+    SymbolicObservationEnv.__name__,
     wrap.__name__,
 ]
@@ -0,0 +1,50 @@
+"""An environment wrapper for symbolic tile and sprite observations."""
+import gym
+import numpy as np
+
+
+class SymbolicObservationEnv(gym.ObservationWrapper):
+    """An environment that observes tiles and sprites instead of frames."""
+
+    def __init__(self, env):
+        """
+        Create a new symbolic observation wrapper.
+
+        Rendering is disabled, so steps cost about as much as emulating the
+        CPU alone.
+
+        Args:
+            env (gym.Env): the environment to wrap
+
+        Returns:
+            None
+
+        """
+        super(SymbolicObservationEnv, self).__init__(env)
+        self.env.unwrapped._set_render(False)
+        # set up a new observation space
+        self.observation_space = gym.spaces.Dict({
+            'tiles': gym.spaces.Box(low=0, high=255, shape=(30, 32), dtype=np.uint8),
+            'palettes': gym.spaces.Box(low=0, high=3, shape=(30, 32), dtype=np.uint8),
+            'sprites': gym.spaces.Box(low=0, high=255, shape=(64, 4), dtype=np.uint8),
+            'scroll': gym.spaces.Box(low=0, high=7, shape=(2,), dtype=np.uint8),
+            'tables': gym.spaces.Box(low=0, high=16, shape=(3,), dtype=np.uint8),
+        })
+
+    def observation(self, frame):
+        """
+        Replace a frame with a symbolic observation of the screen.
+
+        Args:
+            frame (numpy.ndarray): the frame (unused, rendering is disabled)
+
+        Returns:
+            (dict) the tiles, palettes, sprites, scroll, and pattern tables
+            (see NESEnv._observe)
+
+        """
+        return self.env.unwrapped._observe()
+
+
+# explicitly define the outward facing API of this module
+__all__ = [SymbolicObservationEnv.__name__]
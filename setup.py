@@ -1,4 +1,5 @@
 """The setup script for installing and distributing the nes-py package."""
+import os
 import platform
 from glob import glob
 from setuptools import setup, find_packages, Extension
@@ -23,6 +24,9 @@ cpp = glob('nes_py/laines/*.cpp') + glob('nes_py/laines/mappers/*.cpp')
 hpp = ['nes_py/laines/include']
 # Additional build arguments to pass to the compiler
 compile_args = ['-O3', '-march=native', '-std=c++1y']
+# Compile the hardware counters in when NES_COUNTERS is set in the environment
+if os.environ.get('NES_COUNTERS'):
+    compile_args.append('-DNES_COUNTERS')
 # The official extension using the name, source, headers, and build args
 lib_nes_env = Extension(lib_name,
     sources=cpp,